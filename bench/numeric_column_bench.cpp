@@ -0,0 +1,115 @@
+/**
+ * numeric_column_bench.cpp
+ *
+ * Copyright 2008-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "numeric_column.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+namespace
+{
+	NumericVariant alternative(size_t index, std::uint32_t seed) {
+		switch (index) {
+		case 1:		return (seed & 1) != 0;
+		case 2:		return (std::int8_t)seed;
+		case 3:		return (std::int16_t)seed;
+		case 4:		return (std::int32_t)seed;
+		case 5:		return (std::int64_t)seed;
+		case 6:		return (std::uint8_t)seed;
+		case 7:		return (std::uint16_t)seed;
+		case 8:		return (std::uint32_t)seed;
+		case 9:		return (std::uint64_t)seed;
+		case 10:	return (float)seed;
+		default:	return (double)seed;
+		}
+	}
+
+	template<typename Func>
+	void report(const char *name, size_t cells, int passes, Func &&convert) {
+		double sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			sum += convert();
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%-44s %8.2f ns/cell (%g)\n", name, (double)elapsed / ((double)cells * passes), sum);
+	}
+
+	template<typename T>
+	void run(const char *label, const char *target, const std::vector<NumericVariant> &values, const NumericColumn &column, int passes) {
+		std::vector<T> out(values.size());
+		char name[128];
+		std::snprintf(name, sizeof(name), "%s: variantTo<%s> per cell", label, target);
+		report(name, values.size(), passes, [&]() {
+			for (size_t i = 0; i < values.size(); i++)
+				variantTo(values[i], &out[i]);
+			return (double)out.back();
+		});
+		std::snprintf(name, sizeof(name), "%s: NumericColumn to %s", label, target);
+		report(name, values.size(), passes, [&]() {
+			if constexpr (std::is_same_v<T, double>)
+				column.toDouble(out.data());
+			else if constexpr (std::is_same_v<T, float>)
+				column.toFloat(out.data());
+			else if constexpr (std::is_same_v<T, std::int32_t>)
+				column.toInt32(out.data());
+			else
+				column.toInt64(out.data());
+			return (double)out.back();
+		});
+	}
+
+	void run(const char *label, const std::vector<NumericVariant> &values, int passes) {
+		NumericColumn column(values);
+		std::printf("%-44s %8.2f bytes/cell, vector<NumericVariant> %zu\n", label, (double)column.memoryUsage() / values.size(), sizeof(NumericVariant));
+		run<double>(label, "double", values, column, passes);
+		run<float>(label, "float", values, column, passes);
+		run<std::int32_t>(label, "int32", values, column, passes);
+		run<std::int64_t>(label, "int64", values, column, passes);
+	}
+}
+
+
+int main(int argc, char *argv[]) {
+	size_t cells = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const int passes = 10;
+
+	for (size_t index = 1; index < std::variant_size_v<NumericVariant>; index++) {
+		std::vector<NumericVariant> values;
+		values.reserve(cells);
+		for (size_t i = 0; i < cells; i++)
+			values.push_back(alternative(index, (std::uint32_t)i));
+		char label[32];
+		std::snprintf(label, sizeof(label), "alternative %zu", index);
+		run(label, values, passes);
+	}
+
+	// every alternative mixed together, stored in the tagged layout
+	std::vector<NumericVariant> mixed;
+	mixed.reserve(cells);
+	std::uint32_t state = 12345;
+	for (size_t i = 0; i < cells; i++) {
+		state = state * 1664525 + 1013904223;
+		mixed.push_back(alternative(1 + (state >> 8) % (std::variant_size_v<NumericVariant> - 1), state >> 16));
+	}
+	run("mixed", mixed, passes);
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * numeric_variant_bench.cpp
+ *
+ * Copyright 2008-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "propsysreplacement.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+namespace
+{
+	// the holds_alternative cascade that variantTo replaced, kept to compare against
+	bool legacyVariantToDouble(const NumericVariant &varIn, double *pdblRet) {
+		if (std::holds_alternative<double>(varIn))
+			*pdblRet = std::get<double>(varIn);
+		else if (std::holds_alternative<float>(varIn))
+			*pdblRet = std::get<float>(varIn);
+		else if (std::holds_alternative<std::int8_t>(varIn))
+			*pdblRet = (double)std::get<std::int8_t>(varIn);
+		else if (std::holds_alternative<std::int16_t>(varIn))
+			*pdblRet = (double)std::get<std::int16_t>(varIn);
+		else if (std::holds_alternative<std::int32_t>(varIn))
+			*pdblRet = (double)std::get<std::int32_t>(varIn);
+		else if (std::holds_alternative<std::int64_t>(varIn))
+			*pdblRet = (double)std::get<std::int64_t>(varIn);
+		else if (std::holds_alternative<std::uint8_t>(varIn))
+			*pdblRet = (double)std::get<std::uint8_t>(varIn);
+		else if (std::holds_alternative<std::uint16_t>(varIn))
+			*pdblRet = (double)std::get<std::uint16_t>(varIn);
+		else if (std::holds_alternative<std::uint32_t>(varIn))
+			*pdblRet = (double)std::get<std::uint32_t>(varIn);
+		else if (std::holds_alternative<std::uint64_t>(varIn))
+			*pdblRet = (double)std::get<std::uint64_t>(varIn);
+		else {
+			*pdblRet = 0.0;
+			return false;
+		}
+		return true;
+	}
+
+	bool legacyVariantToInt32(const NumericVariant &varIn, std::int32_t *retval) {
+		if (std::holds_alternative<bool>(varIn))
+			*retval = (std::get<bool>(varIn)) ? 1 : 0;
+		else if (std::holds_alternative<std::int8_t>(varIn))
+			*retval = (std::get<std::int8_t>(varIn));
+		else if (std::holds_alternative<std::int16_t>(varIn))
+			*retval = (std::get<std::int16_t>(varIn));
+		else if (std::holds_alternative<std::int32_t>(varIn))
+			*retval = (std::get<std::int32_t>(varIn));
+		else if (std::holds_alternative<std::int64_t>(varIn))
+			*retval = (std::int32_t)(std::get<std::int64_t>(varIn));
+		else if (std::holds_alternative<std::uint8_t>(varIn))
+			*retval = (std::get<std::uint8_t>(varIn));
+		else if (std::holds_alternative<std::uint16_t>(varIn))
+			*retval = (std::get<std::uint16_t>(varIn));
+		else if (std::holds_alternative<std::uint32_t>(varIn))
+			*retval = (std::get<std::uint32_t>(varIn));
+		else if (std::holds_alternative<std::uint64_t>(varIn))
+			*retval = (std::int32_t)(std::get<std::uint64_t>(varIn));
+		else if (std::holds_alternative<float>(varIn))
+			*retval = (std::int32_t)(std::get<float>(varIn) + 0.5);
+		else if (std::holds_alternative<double>(varIn))
+			*retval = (std::int32_t)(std::get<double>(varIn) + 0.5);
+		else {
+			*retval = 0;
+			return false;
+		}
+		return true;
+	}
+
+	NumericVariant alternative(size_t index, std::uint32_t seed) {
+		switch (index) {
+		case 1:		return (seed & 1) != 0;
+		case 2:		return (std::int8_t)seed;
+		case 3:		return (std::int16_t)seed;
+		case 4:		return (std::int32_t)seed;
+		case 5:		return (std::int64_t)seed;
+		case 6:		return (std::uint8_t)seed;
+		case 7:		return (std::uint16_t)seed;
+		case 8:		return (std::uint32_t)seed;
+		case 9:		return (std::uint64_t)seed;
+		case 10:	return (float)seed;
+		default:	return (double)seed;
+		}
+	}
+
+	template<typename T, typename Func>
+	void report(const char *name, const std::vector<NumericVariant> &column, int passes, Func &&convert) {
+		T sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++) {
+			for (auto &cell : column) {
+				T value;
+				if (convert(cell, &value))
+					sum += value;
+			}
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%-40s %8.2f ns/cell (%g)\n", name, (double)elapsed / ((double)column.size() * passes), (double)sum);
+	}
+
+	void run(const char *label, const std::vector<NumericVariant> &column, int passes) {
+		char name[128];
+		std::snprintf(name, sizeof(name), "%s: cascade to double", label);
+		report<double>(name, column, passes, legacyVariantToDouble);
+		std::snprintf(name, sizeof(name), "%s: variantToDouble", label);
+		report<double>(name, column, passes, variantToDouble);
+		std::snprintf(name, sizeof(name), "%s: variantTo<double>, inlined", label);
+		report<double>(name, column, passes, [](const NumericVariant &cell, double *value) { return variantTo(cell, value); });
+		std::snprintf(name, sizeof(name), "%s: cascade to int32", label);
+		report<std::int32_t>(name, column, passes, legacyVariantToInt32);
+		std::snprintf(name, sizeof(name), "%s: variantToInt32", label);
+		report<std::int32_t>(name, column, passes, variantToInt32);
+		std::snprintf(name, sizeof(name), "%s: variantTo<int32>, inlined", label);
+		report<std::int32_t>(name, column, passes, [](const NumericVariant &cell, std::int32_t *value) { return variantTo(cell, value); });
+	}
+}
+
+
+int main(int argc, char *argv[]) {
+	size_t cells = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const int passes = 10;
+
+	// a column of one type, for each type, where the cascade's cost depends on the type's position
+	for (size_t index = 1; index < std::variant_size_v<NumericVariant>; index++) {
+		std::vector<NumericVariant> column;
+		column.reserve(cells);
+		for (size_t i = 0; i < cells; i++)
+			column.push_back(alternative(index, (std::uint32_t)i));
+		char label[32];
+		std::snprintf(label, sizeof(label), "alternative %zu", index);
+		run(label, column, passes);
+	}
+
+	// every alternative mixed together, so the branches can't be predicted
+	std::vector<NumericVariant> mixed;
+	mixed.reserve(cells);
+	std::uint32_t state = 12345;
+	for (size_t i = 0; i < cells; i++) {
+		state = state * 1664525 + 1013904223;
+		mixed.push_back(alternative(1 + (state >> 8) % (std::variant_size_v<NumericVariant> - 1), state >> 16));
+	}
+	run("mixed", mixed, passes);
+
+	return 0;
+}
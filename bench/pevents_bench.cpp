@@ -0,0 +1,133 @@
+/**
+ * pevents_bench.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pevents.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace neosmart;
+
+
+namespace
+{
+	template<typename Func>
+	void report(const char* name, std::uint64_t iterations, Func&& func)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func(iterations);
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%-32s %10.1f ns/op %14.0f ops/s\n", name, (double)elapsed / iterations, iterations * 1e9 / (double)elapsed);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	//checking an event that is already signaled
+	report("wait signaled manual-reset", iterations, [](std::uint64_t count)
+		{
+			neosmart_event_t event = CreateEvent(true, true);
+			for (std::uint64_t i = 0; i < count; i++)
+				WaitForEvent(event, 0);
+			DestroyEvent(event);
+		});
+
+	//signaling an event that nobody is waiting on
+	report("set+reset, no waiters", iterations, [](std::uint64_t count)
+		{
+			neosmart_event_t event = CreateEvent(true, false);
+			for (std::uint64_t i = 0; i < count; i++)
+			{
+				SetEvent(event);
+				ResetEvent(event);
+			}
+			DestroyEvent(event);
+		});
+
+	report("set+wait auto-reset, one thread", iterations, [](std::uint64_t count)
+		{
+			neosmart_event_t event = CreateEvent(false, false);
+			for (std::uint64_t i = 0; i < count; i++)
+			{
+				SetEvent(event);
+				WaitForEvent(event);
+			}
+			DestroyEvent(event);
+		});
+
+	//a high signal rate with a consumer that is usually blocked
+	report("ping-pong auto-reset, two threads", iterations / 10, [](std::uint64_t count)
+		{
+			neosmart_event_t ping = CreateEvent(false, false);
+			neosmart_event_t pong = CreateEvent(false, false);
+			std::thread other([&]()
+				{
+					for (std::uint64_t i = 0; i < count; i++)
+					{
+						WaitForEvent(ping);
+						SetEvent(pong);
+					}
+				});
+			for (std::uint64_t i = 0; i < count; i++)
+			{
+				SetEvent(ping);
+				WaitForEvent(pong);
+			}
+			other.join();
+			DestroyEvent(ping);
+			DestroyEvent(pong);
+		});
+
+	//the same handoff with a spin-then-yield budget, the consumer usually catches the signal before blocking
+	report("ping-pong adaptive, two threads", iterations / 10, [](std::uint64_t count)
+		{
+			neosmart_event_attr_t attributes;
+			attributes.SpinCount = 4000;
+			attributes.YieldCount = 50;
+			neosmart_event_t ping = CreateEvent(attributes);
+			neosmart_event_t pong = CreateEvent(attributes);
+			std::thread other([&]()
+				{
+					for (std::uint64_t i = 0; i < count; i++)
+					{
+						WaitForEvent(ping);
+						SetEvent(pong);
+					}
+				});
+			for (std::uint64_t i = 0; i < count; i++)
+			{
+				SetEvent(ping);
+				WaitForEvent(pong);
+			}
+			other.join();
+
+			neosmart_event_stats_t stats;
+			GetEventWaitStats(pong, stats);
+			std::printf("    spins %llu yields %llu blocks %llu\n", (unsigned long long)stats.Spins,
+				(unsigned long long)stats.Yields, (unsigned long long)stats.Blocks);
+			DestroyEvent(ping);
+			DestroyEvent(pong);
+		});
+
+	return 0;
+}
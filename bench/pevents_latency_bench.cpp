@@ -0,0 +1,63 @@
+/**
+ * pevents_latency_bench.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pevents.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace neosmart;
+
+
+namespace
+{
+	//How long past its timeout a wait on an event that is never signaled returns
+	void overshoot(neosmart_event_t event, std::chrono::nanoseconds timeout, int samples)
+	{
+		std::vector<std::int64_t> late;
+		late.reserve(samples);
+		for (int i = 0; i < samples; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			WaitForEvent(event, timeout);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			late.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed - timeout).count());
+		}
+		std::sort(late.begin(), late.end());
+		auto percentile = [&late](double p) { return late[std::min(late.size() - 1, (size_t)(p * late.size()))] / 1000.0; };
+		std::printf("timeout %8.0f us  overshoot us: min %8.1f p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f\n",
+			timeout.count() / 1000.0, late.front() / 1000.0, percentile(0.5), percentile(0.99), percentile(0.999), late.back() / 1000.0);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	int samples = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+	neosmart_event_t event = CreateEvent(true, false);
+	overshoot(event, std::chrono::microseconds(10), samples);
+	overshoot(event, std::chrono::microseconds(50), samples);
+	overshoot(event, std::chrono::microseconds(200), samples);
+	overshoot(event, std::chrono::milliseconds(1), samples / 4);
+	DestroyEvent(event);
+	return 0;
+}
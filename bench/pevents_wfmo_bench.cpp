@@ -0,0 +1,76 @@
+/**
+ * pevents_wfmo_bench.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pevents.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+
+int main(int argc, char* argv[])
+{
+	std::uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	const int eventCount = 64;
+
+	std::vector<neosmart_event_t> events;
+	for (int i = 0; i < eventCount; i++)
+		events.push_back(CreateEvent(false, false));
+	neosmart_event_t done = CreateEvent(false, false);
+
+	//a dispatcher waiting on 64 events in a loop, fed by a producer that signals one at a time
+	auto start = std::chrono::steady_clock::now();
+	std::thread dispatcher([&]()
+		{
+			for (std::uint64_t i = 0; i < iterations; i++)
+			{
+				int index;
+				WaitForMultipleEvents(events.data(), eventCount, false, -1ul, index);
+				SetEvent(done);
+			}
+		});
+	for (std::uint64_t i = 0; i < iterations; i++)
+	{
+		SetEvent(events[i % eventCount]);
+		WaitForEvent(done);
+	}
+	dispatcher.join();
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	std::printf("%-32s %10.1f ns/op %14.0f ops/s\n", "wait any of 64, two threads", (double)elapsed / iterations, iterations * 1e9 / (double)elapsed);
+
+	//every event already signaled, the wait completes while registering
+	start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = 0; i < iterations; i++)
+	{
+		SetEvent(events[eventCount - 1]);
+		int index;
+		WaitForMultipleEvents(events.data(), eventCount, false, -1ul, index);
+	}
+	elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	std::printf("%-32s %10.1f ns/op %14.0f ops/s\n", "wait any of 64, last signaled", (double)elapsed / iterations, iterations * 1e9 / (double)elapsed);
+
+	for (auto event : events)
+		DestroyEvent(event);
+	DestroyEvent(done);
+	return 0;
+}
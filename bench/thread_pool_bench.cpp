@@ -0,0 +1,107 @@
+/**
+ * thread_pool_bench.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+namespace
+{
+	double since(std::chrono::steady_clock::time_point start)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//a binary tree of tasks, each one queues its children and returns without waiting on them
+	void spawn(hss::thread_pool& pool, int depth, std::atomic<size_t>& remaining, neosmart::neosmart_event_t done)
+	{
+		if (depth)
+		{
+			pool.submit([&pool, depth, &remaining, done]() { spawn(pool, depth - 1, remaining, done); });
+			pool.submit([&pool, depth, &remaining, done]() { spawn(pool, depth - 1, remaining, done); });
+		}
+		else if (remaining.fetch_sub(1) == 1)
+			neosmart::SetEvent(done);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+	hss::thread_pool pool;
+	std::printf("%zu workers on %zu NUMA node(s)\n", pool.thread_count(), pool.node_count());
+
+	//throughput: many small independent tasks submitted from outside the pool
+	{
+		std::vector<hss::task_future<void>> futures;
+		futures.reserve(tasks);
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < tasks; i++)
+			futures.push_back(pool.submit([]() { }));
+		for (auto& future : futures)
+			future.wait();
+		double elapsed = since(start);
+		std::printf("%-32s %10.1f ns/task %14.0f tasks/s\n", "submit+wait, external", elapsed / tasks, tasks * 1e9 / elapsed);
+	}
+
+	//throughput: tasks spawned by tasks, exercising the local queues and stealing
+	{
+		const int depth = 17;
+		std::atomic<size_t> remaining{ (size_t)1 << depth };
+		neosmart::neosmart_event_t done = neosmart::CreateEvent(true, false);
+		auto start = std::chrono::steady_clock::now();
+		pool.submit([&pool, &remaining, done]() { spawn(pool, depth, remaining, done); });
+		neosmart::WaitForEvent(done);
+		double elapsed = since(start);
+		size_t count = ((size_t)2 << depth) - 1;
+		std::printf("%-32s %10.1f ns/task %14.0f tasks/s\n", "recursive spawn", elapsed / count, count * 1e9 / elapsed);
+		neosmart::DestroyEvent(done);
+	}
+
+	//latency: one task at a time, from submit to the task starting and to the caller seeing it finish
+	{
+		size_t samples = std::min<size_t>(tasks, 20000);
+		std::vector<double> startLatency, roundTrip;
+		startLatency.reserve(samples);
+		roundTrip.reserve(samples);
+		for (size_t i = 0; i < samples; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			auto future = pool.submit([start]() { return since(start); });
+			startLatency.push_back(future.get());
+			roundTrip.push_back(since(start));
+		}
+		auto report = [](const char* name, std::vector<double>& values)
+		{
+			std::sort(values.begin(), values.end());
+			auto percentile = [&values](double p) { return values[std::min(values.size() - 1, (size_t)(p * values.size()))] / 1000.0; };
+			std::printf("%-32s us: p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f\n", name, percentile(0.5), percentile(0.99), percentile(0.999), values.back() / 1000.0);
+		};
+		report("submit to start", startLatency);
+		report("submit to result", roundTrip);
+	}
+
+	return 0;
+}
@@ -27,25 +27,527 @@
 #else
 #include <unistd.h>
 #include <pwd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 #include <sys/types.h>
 #include "filesystem.hpp"
 
 #include <boost/property_tree/info_parser.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
 
 namespace tree = boost::property_tree;
 
 
+struct IniSettings::Value
+{
+    std::string text;
+    boost::optional<int> asInt;
+    boost::optional<unsigned long> asLong;
+    boost::optional<std::uint64_t> asLongLong;
+    boost::optional<double> asDouble;
+    boost::optional<bool> asBool;
+};
+
+struct IniSettings::Snapshot
+{
+    using Map = std::unordered_map<std::string, Value>;
+
+    //shared with the snapshots that came before it, up to the last time it was rebuilt
+    std::shared_ptr<Map> values;
+    //the values written since, so a write doesn't have to copy everything
+    Map changed;
+
+    const Value *find(const std::string &path) const
+    {
+        if (changed.size())
+        {
+            auto it = changed.find(path);
+            if (it != changed.end())
+                return &it->second;
+        }
+        auto it = values->find(path);
+        return it != values->end() ? &it->second : nullptr;
+    }
+};
+
+struct IniSettings::Slot
+{
+    std::uint64_t id = 0;
+    std::uint64_t generation = 0;
+    std::shared_ptr<const Snapshot> snapshot;
+};
+
+struct IniSettings::LazyFile
+{
+    struct Group
+    {
+        std::string name;
+        //where each top level entry with this name is in the file, a name can appear more than once
+        std::vector<std::pair<size_t, size_t>> segments;
+    };
+
+    //a copy of the file rather than a mapping, so that another process truncating or rewriting it
+    //in place can't pull the text out from under a group that hasn't been parsed yet
+    std::string contents;
+    //sorted by name, never changes once indexed so it can be searched without the lock
+    std::vector<Group> groups;
+    std::unique_ptr<std::atomic<bool>[]> loaded;
+
+    const Group *find(std::string_view name) const
+    {
+        auto it = std::lower_bound(groups.begin(), groups.end(), name, [](const Group &group, std::string_view name) { return group.name < name; });
+        return it != groups.end() && it->name == name ? &*it : nullptr;
+    }
+};
+
+/*
+ * The blob store is append only:
+ *
+ *   "HSSBLOB1"
+ *   records, each: FNV-1a 64 hash of the bytes, length (uint32), 4 reserved bytes, the bytes,
+ *                  padding to a multiple of 8
+ *
+ * Views that have been handed out have to stay valid after later appends, so nothing is unmapped
+ * until the store is closed. Instead of mapping the whole file again as it grows only the part that
+ * hasn't been mapped yet is. On POSIX address space is reserved up front for each region and the
+ * file is mapped into it a piece at a time, the kernel merges the pieces into a single mapping. On
+ * Windows a view can't be extended, so each region is a view of what was appended since the last.
+ *
+ * The store is shared between processes. Reading what's been appended takes a shared OS lock on the
+ * file and appending an exclusive one, held until the record is complete, so a record that's still
+ * being written is never indexed or cut short by someone else.
+ */
+struct IniSettings::BlobStore
+{
+    static constexpr char magic[8] = { 'H', 'S', 'S', 'B', 'L', 'O', 'B', '1' };
+    static constexpr size_t headerSize = 16;
+    //the least address space reserved for a region, regions are reserved at twice what they need
+    static constexpr size_t reserveSize = (size_t)64 << 20;
+
+    struct Region
+    {
+        //where in the file base is
+        size_t offset;
+        //the address space reserved at base
+        size_t capacity;
+        //the bytes of the file mapped so far
+        size_t mapped;
+        char *base;
+    #ifdef _MSC_VER
+        HANDLE mapping;
+    #endif
+    };
+
+    std::string path;
+#ifdef _MSC_VER
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    std::vector<Region> regions;
+    //the bytes and length of each blob
+    std::unordered_map<std::uint64_t, std::pair<const char *, std::uint32_t>> index;
+    //the end of the last complete record
+    size_t scanned = 0;
+    bool corrupt = false;
+
+    struct FileLock
+    {
+        BlobStore &store;
+        bool locked;
+
+        FileLock(BlobStore &s, bool exclusive) : store(s), locked(s.lock(exclusive)) { }
+        ~FileLock()
+        {
+            if (locked)
+                store.unlock();
+        }
+    };
+
+    explicit BlobStore(std::string p) : path(std::move(p))
+    {
+        if (open(false))
+        {
+            FileLock lock(*this, false);
+            if (lock.locked)
+                refresh();
+        }
+    }
+    BlobStore(const BlobStore &) = delete;
+    BlobStore &operator=(const BlobStore &) = delete;
+
+    ~BlobStore()
+    {
+        for (auto &region : regions)
+        {
+    #ifdef _MSC_VER
+            UnmapViewOfFile(region.base);
+            CloseHandle(region.mapping);
+    #else
+            munmap(region.base, region.capacity);
+    #endif
+        }
+    #ifdef _MSC_VER
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+    #else
+        if (fd >= 0)
+            close(fd);
+    #endif
+    }
+
+    //open for writing if possible, creating the file only if asked to
+    bool open(bool create)
+    {
+    #ifdef _MSC_VER
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE && !create)
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        }
+        return file != INVALID_HANDLE_VALUE;
+    #else
+        if (fd < 0)
+        {
+            fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+            if (fd < 0 && !create)
+                fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        return fd >= 0;
+    #endif
+    }
+
+    bool lock(bool exclusive)
+    {
+    #ifdef _MSC_VER
+        OVERLAPPED overlapped = {};
+        return LockFileEx(file, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD, MAXDWORD, &overlapped) != FALSE;
+    #else
+        int result;
+        while ((result = flock(fd, exclusive ? LOCK_EX : LOCK_SH)) && errno == EINTR)
+            ;
+        return result == 0;
+    #endif
+    }
+
+    void unlock()
+    {
+    #ifdef _MSC_VER
+        OVERLAPPED overlapped = {};
+        UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &overlapped);
+    #else
+        flock(fd, LOCK_UN);
+    #endif
+    }
+
+    bool truncate(size_t size)
+    {
+    #ifdef _MSC_VER
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)size;
+        return SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    #else
+        return ftruncate(fd, (off_t)size) == 0;
+    #endif
+    }
+
+    bool writeAt(size_t offset, const void *data, size_t length)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (length)
+        {
+    #ifdef _MSC_VER
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)((std::uint64_t)offset >> 32);
+            DWORD written;
+            if (!WriteFile(file, bytes, (DWORD)std::min(length, (size_t)0x40000000), &written, &overlapped) || !written)
+                return false;
+    #else
+            ssize_t written = pwrite(fd, bytes, length, (off_t)offset);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+    #endif
+            bytes += written;
+            offset += (size_t)written;
+            length -= (size_t)written;
+        }
+        return true;
+    }
+
+    size_t fileSize()
+    {
+    #ifdef _MSC_VER
+        LARGE_INTEGER length;
+        return GetFileSizeEx(file, &length) ? (size_t)length.QuadPart : 0;
+    #else
+        struct stat info;
+        return fstat(fd, &info) ? 0 : (size_t)info.st_size;
+    #endif
+    }
+
+    //make sure everything from scanned to size is mapped, in the last region
+    bool mapTo(size_t size)
+    {
+    #ifdef _MSC_VER
+        if (regions.size() && size <= regions.back().offset + regions.back().mapped)
+            return true;
+        SYSTEM_INFO system;
+        GetSystemInfo(&system);
+        Region region;
+        region.offset = scanned - scanned % system.dwAllocationGranularity;
+        region.mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!region.mapping)
+            return false;
+        region.base = static_cast<char *>(MapViewOfFile(region.mapping, FILE_MAP_READ, (DWORD)((std::uint64_t)region.offset >> 32), (DWORD)region.offset, size - region.offset));
+        if (!region.base)
+        {
+            CloseHandle(region.mapping);
+            return false;
+        }
+        region.capacity = region.mapped = size - region.offset;
+        regions.push_back(region);
+        return true;
+    #else
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        if (regions.empty() || size > regions.back().offset + regions.back().capacity)
+        {
+            Region region;
+            region.offset = scanned & ~(page - 1);
+            size_t needed = (size - region.offset + page - 1) & ~(page - 1);
+            region.capacity = std::max(reserveSize, needed * 2);
+            void *base = mmap(nullptr, region.capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (base == MAP_FAILED)
+            {
+                //short on address space, reserve only what's needed now
+                region.capacity = needed;
+                base = mmap(nullptr, region.capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (base == MAP_FAILED)
+                    return false;
+            }
+            region.base = static_cast<char *>(base);
+            region.mapped = 0;
+            regions.push_back(region);
+        }
+        Region &region = regions.back();
+        size_t end = std::min(region.capacity, (size - region.offset + page - 1) & ~(page - 1));
+        if (end > region.mapped)
+        {
+            if (mmap(region.base + region.mapped, end - region.mapped, PROT_READ, MAP_SHARED | MAP_FIXED, fd, (off_t)(region.offset + region.mapped)) == MAP_FAILED)
+                return false;
+            region.mapped = end;
+        }
+        return true;
+    #endif
+    }
+
+    //index anything appended since the file was last mapped, called with the file locked, false if
+    //there may be complete records that couldn't be indexed
+    bool refresh()
+    {
+        if (corrupt)
+            return false;
+        size_t size = fileSize();
+        if (size < sizeof(magic) || size <= scanned)
+            return true;
+        if (!mapTo(size))
+            return false;
+        const Region &region = regions.back();
+        if (!scanned)
+        {
+            if (memcmp(region.base, magic, sizeof(magic)))
+            {
+                corrupt = true;
+                return false;
+            }
+            scanned = sizeof(magic);
+        }
+        while (scanned + headerSize <= size)
+        {
+            const char *record = region.base + (scanned - region.offset);
+            std::uint64_t hash;
+            std::uint32_t length;
+            memcpy(&hash, record, sizeof(hash));
+            memcpy(&length, record + sizeof(hash), sizeof(length));
+            if (size - scanned - headerSize < length)
+                break;
+            index.emplace(hash, std::make_pair(record + headerSize, length));
+            scanned += headerSize + ((length + 7) & ~(size_t)7);
+        }
+        return true;
+    }
+
+    BlobView find(std::uint64_t hash)
+    {
+        auto it = index.find(hash);
+        if (it == index.end())
+        {
+            //another process may have added it
+            if (!open(false))
+                return BlobView();
+            {
+                FileLock lock(*this, false);
+                if (lock.locked)
+                    refresh();
+            }
+            it = index.find(hash);
+            if (it == index.end())
+                return BlobView();
+        }
+        BlobView view;
+        view.data = reinterpret_cast<const std::uint8_t *>(it->second.first);
+        view.size = it->second.second;
+        return view;
+    }
+
+    //false if the blob couldn't be written, or if different bytes are already stored with the same hash
+    bool store(std::uint64_t hash, const std::uint8_t *data, std::uint32_t len)
+    {
+        if (!open(true))
+            return false;
+        FileLock lock(*this, true);
+        if (!lock.locked || !refresh())
+            return false;
+        auto existing = index.find(hash);
+        if (existing != index.end())
+            return existing->second.second == len && !memcmp(existing->second.first, data, len);
+
+        //every writer holds the lock until its record is complete, so anything past the last complete
+        //record was left by one that failed part way through
+        if (fileSize() > scanned && !truncate(scanned))
+            return false;
+        size_t offset = scanned;
+        if (!offset)
+        {
+            if (!writeAt(0, magic, sizeof(magic)))
+                return false;
+            offset = sizeof(magic);
+        }
+        char header[headerSize] = {};
+        memcpy(header, &hash, sizeof(hash));
+        memcpy(header + sizeof(hash), &len, sizeof(len));
+        static const char padding[8] = {};
+        if (!writeAt(offset, header, sizeof(header)) ||
+            !writeAt(offset + headerSize, data, len) ||
+            !writeAt(offset + headerSize + len, padding, ((len + 7) & ~(size_t)7) - len))
+            return false;
+        return refresh() && index.find(hash) != index.end();
+    }
+};
+
+
+namespace
+{
+    //identifies instances in the per-thread snapshot cache, unlike addresses these are never reused
+    std::atomic<std::uint64_t> s_nextId{ 1 };
+
+    //reads mapped memory through a stream without copying it
+    class memory_buffer : public std::streambuf
+    {
+    public:
+        memory_buffer(const char *data, size_t size)
+        {
+            char *begin = const_cast<char *>(data);
+            setg(begin, begin, begin + size);
+        }
+    };
+
+    //the part of a group name that's a child of the root
+    std::string_view topLevel(std::string_view group_name)
+    {
+        return group_name.substr(0, group_name.find('|'));
+    }
+
+    std::uint64_t fnv1a(const std::uint8_t *data, std::uint32_t len)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::uint32_t i = 0; i < len; i++)
+        {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    //blobs are referenced from the tree as "blob:" and 16 hex digits of the hash
+    constexpr size_t blobReferenceLength = 21;
+
+    bool parseBlobReference(const std::string &text, std::uint64_t &hash)
+    {
+        if (text.length() != blobReferenceLength || text.compare(0, 5, "blob:"))
+            return false;
+        hash = 0;
+        for (size_t i = 5; i < blobReferenceLength; i++)
+        {
+            char c = text[i];
+            int digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else
+                return false;
+            hash = (hash << 4) | (std::uint64_t)digit;
+        }
+        return true;
+    }
+
+    template<typename Value>
+    void parse(const tree::ptree &node, Value &value)
+    {
+        value.text = node.data();
+        value.asInt = node.template get_value_optional<int>();
+        value.asLong = node.template get_value_optional<unsigned long>();
+        value.asLongLong = node.template get_value_optional<std::uint64_t>();
+        value.asDouble = node.template get_value_optional<double>();
+        value.asBool = node.template get_value_optional<bool>();
+    }
+
+    template<typename Map>
+    void flatten(const tree::ptree &node, bool nested, std::string &path, Map &values)
+    {
+        for (auto &child : node)
+        {
+            size_t length = path.size();
+            if (nested)
+                path += '|';
+            path += child.first;
+            //ptree paths only ever resolve to the first child with a name, later duplicates are unreachable
+            auto inserted = values.try_emplace(path);
+            if (inserted.second)
+            {
+                parse(child.second, inserted.first->second);
+                flatten(child.second, true, path, values);
+            }
+            path.resize(length);
+        }
+    }
+}
+
+
 IniSettings* AfxGetApp()
 {
-    static IniSettings s_instance;
+    static IniSettings s_instance(true, true);
 
     return &s_instance;
 }
 
 
-IniSettings::IniSettings(bool saveOnWrite) :
-    m_saveOnWrite(saveOnWrite)
+IniSettings::IniSettings(bool saveOnWrite, bool lazy) :
+    m_saveOnWrite(saveOnWrite),
+    m_id(s_nextId++)
 {
     char* home;
     if ((home = getenv("HOME")) == nullptr)
@@ -65,18 +567,484 @@ IniSettings::IniSettings(bool saveOnWrite) :
     if (!fs::exists(p))
         fs::create_directory(p);
     p /= "settings.info";
-    if (fs::exists(p))
-        tree::info_parser::read_info(p.string(), m_tree);
     m_path = p.string();
+    Load(lazy);
 #ifdef _MSC_VER
     delete[] home;
 #endif
 }
 
-void IniSettings::Save()
+IniSettings::IniSettings(const std::string &path, bool saveOnWrite, bool lazy) :
+    m_saveOnWrite(saveOnWrite),
+    m_path(path),
+    m_id(s_nextId++)
+{
+    Load(lazy);
+}
+
+IniSettings::~IniSettings()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_flushSignal.notify_one();
+    if (m_flushThread.joinable())
+    {
+        m_flushThread.join();
+        //without write-behind unsaved changes were asked for by the caller, leave them that way
+        if (m_writeBehind.count())
+            Flush();
+    }
+}
+
+void IniSettings::Load(bool lazy)
+{
+    if (!fs::exists(m_path))
+        return;
+    if (!lazy || !IndexGroups())
+        tree::info_parser::read_info(m_path, m_tree);
+}
+
+//Find where each top level entry starts, following the same tokenizing as the info parser but
+//without building the tree. Anything unusual (includes, syntax errors) is left to the full parser.
+bool IniSettings::IndexGroups()
+{
+    namespace info = tree::info_parser;
+
+    auto index = std::make_unique<LazyFile>();
+    {
+        std::ifstream in(m_path, std::ios::binary | std::ios::ate);
+        std::streamoff length = in ? (std::streamoff)in.tellg() : 0;
+        if (length <= 0)
+            return false;
+        index->contents.resize((size_t)length);
+        in.seekg(0);
+        if (!in.read(&index->contents[0], length))
+            return false;
+    }
+    const char *contents = index->contents.data();
+    const size_t size = index->contents.size();
+
+    std::vector<std::pair<std::string, std::pair<size_t, size_t>>> entries;
+    try
+    {
+        enum { key, data, continuation } state = key;
+        int depth = 0;
+        bool haveKey = false;
+        std::string line;
+        size_t lineStart = 0;
+        while (lineStart < size)
+        {
+            const char *begin = contents + lineStart;
+            const char *newline = static_cast<const char *>(memchr(begin, '\n', size - lineStart));
+            size_t lineLength = newline ? (size_t)(newline - begin) : size - lineStart;
+            line.assign(begin, lineLength);
+            const char *text = line.c_str();
+
+            info::skip_whitespace(text);
+            if (*text == '#')
+                return false;
+            for (;;)
+            {
+                info::skip_whitespace(text);
+                if (*text == '\0' || *text == ';')
+                {
+                    if (state == data)
+                        state = key;
+                    break;
+                }
+                if (state == continuation)
+                {
+                    if (*text != '"')
+                        return false;
+                    bool more;
+                    info::read_string(text, &more);
+                    state = more ? continuation : key;
+                }
+                else if (*text == '{')
+                {
+                    if (state == key && !haveKey)
+                        return false;
+                    depth++;
+                    haveKey = false;
+                    text++;
+                    state = key;
+                }
+                else if (*text == '}')
+                {
+                    if (!depth)
+                        return false;
+                    depth--;
+                    haveKey = false;
+                    text++;
+                    state = key;
+                }
+                else if (state == key)
+                {
+                    size_t offset = lineStart + (text - line.c_str());
+                    std::string name = info::read_key(text);
+                    if (!depth)
+                    {
+                        if (entries.size())
+                            entries.back().second.second = offset - entries.back().second.first;
+                        entries.emplace_back(std::move(name), std::make_pair(offset, (size_t)0));
+                    }
+                    haveKey = true;
+                    state = data;
+                }
+                else
+                {
+                    bool more;
+                    info::read_data(text, &more);
+                    state = more ? continuation : key;
+                }
+            }
+            lineStart += lineLength + 1;
+        }
+        if (depth || state == continuation)
+            return false;
+    }
+    catch (tree::info_parser_error &)
+    {
+        return false;
+    }
+    if (entries.size())
+        entries.back().second.second = size - entries.back().second.first;
+
+    //group the entries by name, keeping duplicates in file order
+    std::stable_sort(entries.begin(), entries.end(), [](const auto &left, const auto &right) { return left.first < right.first; });
+    for (auto &entry : entries)
+    {
+        if (index->groups.empty() || index->groups.back().name != entry.first)
+            index->groups.push_back({ std::move(entry.first), {} });
+        index->groups.back().segments.push_back(entry.second);
+    }
+    index->loaded = std::make_unique<std::atomic<bool>[]>(index->groups.size());
+    for (size_t i = 0; i < index->groups.size(); i++)
+        index->loaded[i].store(false, std::memory_order_relaxed);
+    m_lazyRemaining.store(index->groups.size(), std::memory_order_release);
+    m_lazyFile = std::move(index);
+    return true;
+}
+
+bool IniSettings::GroupPending(std::string_view group_name) const
+{
+    if (!m_lazyRemaining.load(std::memory_order_acquire))
+        return false;
+    auto group = m_lazyFile->find(topLevel(group_name));
+    return group && !m_lazyFile->loaded[group - m_lazyFile->groups.data()].load(std::memory_order_acquire);
+}
+
+//called with the lock held
+void IniSettings::LoadGroup(std::string_view group_name)
+{
+    if (!GroupPending(group_name))
+        return;
+
+    auto group = m_lazyFile->find(topLevel(group_name));
+    for (auto &segment : group->segments)
+    {
+        memory_buffer buffer(m_lazyFile->contents.data() + segment.first, segment.second);
+        std::istream stream(&buffer);
+        tree::ptree parsed;
+        tree::info_parser::read_info(stream, parsed);
+        for (auto &child : parsed)
+            m_tree.push_back(tree::ptree::value_type(child.first, tree::ptree()))->second.swap(child.second);
+    }
+    m_lazyFile->loaded[group - m_lazyFile->groups.data()].store(true, std::memory_order_release);
+    //readers may still be searching the group names, only the text can go
+    if (m_lazyRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        std::string().swap(m_lazyFile->contents);
+
+    m_snapshot.reset();
+    m_generation.fetch_add(1, std::memory_order_release);
+}
+
+//called with the lock held
+void IniSettings::LoadAllGroups()
+{
+    if (!m_lazyRemaining.load(std::memory_order_acquire))
+        return;
+    for (auto &group : m_lazyFile->groups)
+        LoadGroup(group.name);
+}
+
+//a name next to path that no other process or instance saving the same settings will pick
+static std::string TempName(const std::string &path)
+{
+    static std::atomic<std::uint32_t> s_count{ 0 };
+    thread_local std::mt19937 t_random(std::random_device{}());
+#ifdef _MSC_VER
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lu.%08x%04x.tmp", pid, (unsigned)t_random(), (unsigned)(s_count.fetch_add(1) & 0xffff));
+    return path + suffix;
+}
+
+//write contents to a new file at path, with sync flush it to disk so that once it's renamed over
+//the settings a crash can't leave an empty or partial file in their place
+static bool WriteSettingsFile(const std::string &path, const std::string &contents, bool sync)
 {
+    const char *bytes = contents.data();
+    size_t length = contents.size();
+#ifdef _MSC_VER
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    bool success = true;
+    while (length && success)
+    {
+        DWORD written;
+        success = WriteFile(file, bytes, (DWORD)std::min(length, (size_t)0x40000000), &written, nullptr) && written;
+        bytes += written;
+        length -= written;
+    }
+    success = success && (!sync || FlushFileBuffers(file));
+    CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd == -1)
+        return false;
+    bool success = true;
+    while (length && success)
+    {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        success = written > 0;
+        if (success)
+        {
+            bytes += written;
+            length -= (size_t)written;
+        }
+    }
+    success = success && (!sync || fsync(fd) == 0);
+    success = (::close(fd) == 0) && success;
+#endif
+    return success;
+}
+
+void IniSettings::Save(bool sync)
+{
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+
+    //only hold the tree lock long enough to serialize it, not for the file IO
+    std::ostringstream contents;
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        LoadAllGroups();
+        tree::info_parser::write_info(contents, m_tree);
+        generation = m_generation.load(std::memory_order_relaxed);
+    }
+
+    //write a temporary file and rename it over the settings so a crash part way through
+    //can't leave a truncated file behind
+    std::string temp = TempName(m_path);
+    std::error_code ec;
+    bool saved = WriteSettingsFile(temp, contents.str(), sync);
+    if (saved)
+    {
+        fs::rename(temp, m_path, ec);
+        saved = !ec;
+    }
+    if (!saved)
+    {
+        weak_assert(false);
+        fs::remove(temp, ec);
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
-    tree::info_parser::write_info(m_path, m_tree);
+    if (!saved)
+    {
+        //leave the settings dirty and have the write behind thread try again after another delay
+        m_dirty = true;
+        m_firstDirty = m_lastWrite = std::chrono::steady_clock::now();
+    }
+    //a write that came in while saving still needs saving
+    else if (m_generation.load(std::memory_order_relaxed) == generation)
+        m_dirty = false;
+}
+
+void IniSettings::Flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dirty)
+            return;
+    }
+    Save();
+}
+
+void IniSettings::SetWriteBehind(std::chrono::milliseconds delay)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writeBehind = delay;
+        if (delay.count() && !m_flushThread.joinable())
+            m_flushThread = std::thread(&IniSettings::FlushThread, this);
+    }
+    m_flushSignal.notify_one();
+    if (!delay.count())
+        Flush();
+}
+
+//called with the lock held after the value at path has been written
+void IniSettings::Changed(std::unique_lock<std::mutex> &lock, const std::string &path)
+{
+    Patch(path);
+    m_generation.fetch_add(1, std::memory_order_release);
+
+    if (m_writeBehind.count())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!m_dirty)
+        {
+            m_dirty = true;
+            m_firstDirty = now;
+        }
+        m_lastWrite = now;
+        lock.unlock();
+        m_flushSignal.notify_one();
+    }
+    else if (m_saveOnWrite)
+    {
+        //an fsync on every write would make a burst of writes far slower than the rewrites already are,
+        //the write-behind thread, Flush and the destructor still sync
+        lock.unlock();
+        Save(false);
+    }
+    else
+        m_dirty = true;
+}
+
+IniSettings::Slot &IniSettings::ThreadSlot(std::uint64_t id)
+{
+    //a few slots so that threads using more than one instance don't keep trading snapshots
+    thread_local Slot t_slots[4];
+    return t_slots[id % 4];
+}
+
+//called with the lock held, bring the snapshot up to date with a write to path instead of
+//flattening the whole tree again on the next read
+void IniSettings::Patch(const std::string &path)
+{
+    if (!m_snapshot)
+        return;
+
+    //the calling thread's copy is out of date after this write anyway, let it go so that the
+    //snapshot can be changed in place when no other thread is reading it
+    Slot &slot = ThreadSlot(m_id);
+    if (slot.id == m_id)
+        slot.snapshot.reset();
+    //other threads only take a reference with the lock held, but drop theirs without it
+    bool shared = m_snapshot.use_count() > 1;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shared)
+        m_snapshot = std::make_shared<Snapshot>(*m_snapshot);
+
+    Snapshot &snapshot = *m_snapshot;
+    //once there are enough changes copy the values rather than copying the changes on every write
+    if (snapshot.values.use_count() > 1 && snapshot.changed.size() >= maxChanged)
+        snapshot.values = std::make_shared<Snapshot::Map>(*snapshot.values);
+    bool own = snapshot.values.use_count() == 1;
+    if (own && snapshot.changed.size())
+    {
+        for (auto &value : snapshot.changed)
+            (*snapshot.values)[value.first] = std::move(value.second);
+        snapshot.changed.clear();
+    }
+    Snapshot::Map &target = own ? *snapshot.values : snapshot.changed;
+
+    //the write may also have added the groups leading to the value
+    for (size_t end = path.find('|'); ; end = path.find('|', end + 1))
+    {
+        std::string prefix = path.substr(0, end);
+        if (end == std::string::npos || !snapshot.find(prefix))
+        {
+            auto node = m_tree.get_child_optional(tree::ptree::path_type(prefix, '|'));
+            if (node)
+                parse(*node, target[prefix]);
+        }
+        if (end == std::string::npos)
+            break;
+    }
+}
+
+const IniSettings::Snapshot &IniSettings::CurrentSnapshot()
+{
+    Slot &slot = ThreadSlot(m_id);
+    if (slot.id != m_id || slot.generation != m_generation.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_snapshot)
+        {
+            auto snapshot = std::make_shared<Snapshot>();
+            snapshot->values = std::make_shared<Snapshot::Map>();
+            std::string path;
+            flatten(m_tree, false, path, *snapshot->values);
+            m_snapshot = std::move(snapshot);
+        }
+        slot.id = m_id;
+        slot.generation = m_generation.load(std::memory_order_relaxed);
+        slot.snapshot = m_snapshot;
+    }
+    return *slot.snapshot;
+}
+
+//only valid until the calling thread's next lookup
+const IniSettings::Value *IniSettings::Find(const char *prefix, const std::string &group_name, const std::string &key)
+{
+    //reuse the buffer instead of building a new path on every read
+    thread_local std::string t_path;
+    t_path.assign(prefix);
+    t_path += group_name;
+    t_path += '|';
+    t_path += key;
+
+    if (const Value *value = CurrentSnapshot().find(t_path))
+        return value;
+
+    //the value may be in a group that hasn't been parsed yet
+    std::string_view group = *prefix ? std::string_view(prefix) : std::string_view(group_name);
+    if (GroupPending(group))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            LoadGroup(group);
+        }
+        return Find(prefix, group_name, key);
+    }
+    return nullptr;
+}
+
+void IniSettings::FlushThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping)
+    {
+        if (!m_dirty || !m_writeBehind.count())
+        {
+            m_flushSignal.wait(lock);
+            continue;
+        }
+
+        //wait for the writes to settle, but don't let a steady stream of them hold the save off forever
+        auto deadline = std::min(m_lastWrite + m_writeBehind, m_firstDirty + m_writeBehind * 10);
+        if (std::chrono::steady_clock::now() < deadline)
+        {
+            m_flushSignal.wait_until(lock, deadline);
+            continue;
+        }
+
+        lock.unlock();
+        Save();
+        lock.lock();
+    }
 }
 
 std::string IniSettings::GetPath()
@@ -87,133 +1055,207 @@ std::string IniSettings::GetPath()
 
 void IniSettings::WriteProfileInt(const std::string &group_name, const std::string &key, int value)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileLong(const std::string &group_name, const std::string &key, unsigned long value)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileLongLong(const std::string &group_name, const std::string &key, std::uint64_t value)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileDouble(const std::string &group_name, const std::string &key, double value, std::string format)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileString(const std::string &group_name, const std::string &key, std::string value)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileBOOL(const std::string &group_name, const std::string &key, bool value)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteProfileBinary(const std::string &group_name, const std::string &key, std::uint8_t* data, std::uint32_t len)
 {
     std::string temp(reinterpret_cast<char *>(data), len);
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
     m_tree.put(place, temp);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
+}
+
+void IniSettings::WriteProfileBlob(const std::string &group_name, const std::string &key, const std::uint8_t* data, std::uint32_t len)
+{
+    std::uint64_t hash = fnv1a(data, len);
+    bool stored;
+    {
+        std::lock_guard<std::mutex> lock(m_blobMutex);
+        if (!m_blobs)
+            m_blobs = std::make_unique<BlobStore>(m_path + ".blobs");
+        stored = m_blobs->store(hash, data, len);
+    }
+    if (!stored)
+    {
+        //keep the bytes in the tree rather than lose them
+        weak_assert(false);
+        WriteProfileBinary(group_name, key, const_cast<std::uint8_t*>(data), len);
+        return;
+    }
+
+    char reference[blobReferenceLength + 1];
+    snprintf(reference, sizeof(reference), "blob:%016llx", (unsigned long long)hash);
+    std::string path = group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup(group_name);
+    m_tree.put(place, std::string(reference));
+    Changed(lock, path);
+}
+
+IniSettings::BlobView IniSettings::FindBlob(std::uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(m_blobMutex);
+    if (!m_blobs)
+        m_blobs = std::make_unique<BlobStore>(m_path + ".blobs");
+    return m_blobs->find(hash);
+}
+
+IniSettings::BlobView IniSettings::GetProfileBlob(const std::string &group_name, const std::string &key)
+{
+    const Value *value = Find("", group_name, key);
+    std::uint64_t hash;
+    if (!value || !parseBlobReference(value->text, hash))
+        return BlobView();
+    return FindBlob(hash);
 }
 
 int IniSettings::GetProfileInt(const std::string &group_name, const std::string &key, int def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value && value->asInt ? *value->asInt : def;
 }
 
 unsigned long IniSettings::GetProfileLong(const std::string &group_name, const std::string &key, unsigned long def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value && value->asLong ? *value->asLong : def;
 }
 
 std::uint64_t IniSettings::GetProfileLongLong(const std::string &group_name, const std::string &key, std::uint64_t def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value && value->asLongLong ? *value->asLongLong : def;
 }
 
 double IniSettings::GetProfileDouble(const std::string &group_name, const std::string &key, double def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value && value->asDouble ? *value->asDouble : def;
 }
 
 std::string IniSettings::GetProfileString(const std::string &group_name, const std::string &key, std::string def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value ? value->text : def;
 }
 
 bool IniSettings::GetProfileBOOL(const std::string &group_name, const std::string &key, bool def)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("", group_name, key);
+    return value && value->asBool ? *value->asBool : def;
 }
 
 void IniSettings::GetProfileBinary(const std::string &group_name, const std::string &key, std::uint8_t** data, std::uint32_t* len)
 {
-    tree::ptree::path_type place = tree::path(group_name + "|" + key, '|');
-    std::string temp = m_tree.get(place, "");
-    *len = temp.length();
-    if (temp.length() > 0)
+    const Value *value = Find("", group_name, key);
+    std::uint64_t hash;
+    if (value && parseBlobReference(value->text, hash))
     {
-        *data = new std::uint8_t[temp.length()];
-        std::copy(temp.begin(), temp.end(), *data);
+        BlobView blob = FindBlob(hash);
+        *len = blob.size;
+        if (*len > 0)
+        {
+            *data = new std::uint8_t[*len];
+            std::copy(blob.begin(), blob.end(), *data);
+        }
+        return;
+    }
+    *len = value ? value->text.length() : 0;
+    if (*len > 0)
+    {
+        *data = new std::uint8_t[*len];
+        std::copy(value->text.begin(), value->text.end(), *data);
     }
 }
 
 void IniSettings::WriteRegistryInt(const std::string &group_name, const std::string &key, int value)
 {
-    tree::ptree::path_type place = tree::path("registry|" + group_name + "|" + key, '|');
+    std::string path = "registry|" + group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup("registry");
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 void IniSettings::WriteRegistryString(const std::string &group_name, const std::string &key, std::string value)
 {
-    tree::ptree::path_type place = tree::path("registry|" + group_name + "|" + key, '|');
+    std::string path = "registry|" + group_name + "|" + key;
+    tree::ptree::path_type place(path, '|');
+    std::unique_lock<std::mutex> lock(m_mutex);
+    LoadGroup("registry");
     m_tree.put(place, value);
-    if (m_saveOnWrite)
-        Save();
+    Changed(lock, path);
 }
 
 int IniSettings::GetRegistryInt(const std::string &group_name, const std::string &key, int def)
 {
-    tree::ptree::path_type place = tree::path("registry|" + group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("registry|", group_name, key);
+    return value && value->asInt ? *value->asInt : def;
 }
 
 std::string IniSettings::GetRegistryString(const std::string &group_name, const std::string &key, std::string def)
 {
-    tree::ptree::path_type place = tree::path("registry|" + group_name + "|" + key, '|');
-    return m_tree.get(place, def);
+    const Value *value = Find("registry|", group_name, key);
+    return value ? value->text : def;
 }
@@ -20,6 +20,15 @@
 #include "Dlgcnvt.h"
 #include <float.h>              // floating point precision
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <shared_mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #ifdef __GNUC__
 #include <stdexcept>
@@ -27,46 +36,90 @@ void AfxThrowNotSupportedException() { throw std::logic_error("AFX Exception");
 #endif
 
 
+static UnitConversion::Profile defaultProfile()
+{
+	UnitConversion::Profile profile;
+	profile.small_measure_display = STORAGE_FORMAT_MM;
+	profile.small_distance_display = STORAGE_FORMAT_M;
+	profile.distance_display = STORAGE_FORMAT_KM;
+	profile.alt_distance_display = STORAGE_FORMAT_M;
+	profile.coordinate_display = STORAGE_COORDINATE_DEGREE;
+	profile.area_display = STORAGE_FORMAT_HECTARE;
+	profile.volume_display = STORAGE_FORMAT_M3;
+	profile.temp_display = STORAGE_FORMAT_CELSIUS;
+	profile.mass_display = STORAGE_FORMAT_KG;
+	profile.energy_display = STORAGE_FORMAT_JOULE;
+	profile.angle_display = STORAGE_FORMAT_DEGREE;
+	profile.velocity_display = STORAGE_FORMAT_KM | STORAGE_FORMAT_HOUR;
+	profile.alt_velocity_display = STORAGE_FORMAT_M | STORAGE_FORMAT_MINUTE;
+	profile.mass_area_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KG << 0x20) | STORAGE_FORMAT_M2;
+	profile.intensity_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KILOWATT_SECOND << 0x20) | STORAGE_FORMAT_M;
+	profile.power_display = STORAGE_FORMAT_KILOWATT_;
+	profile.language_display = "en-ca";
+	return profile;
+}
+
+
 UnitConversion::UnitConversion(const TCHAR *group_name)
 {
-	m_small_measure_display = STORAGE_FORMAT_MM;
-	m_small_distance_display = STORAGE_FORMAT_M;
-	m_distance_display = STORAGE_FORMAT_KM;
-	m_alt_distance_display = STORAGE_FORMAT_M;
-	m_coordinate_display = STORAGE_COORDINATE_DEGREE;
-	m_area_display = STORAGE_FORMAT_HECTARE;
-	m_volume_display = STORAGE_FORMAT_M3;
-	m_temp_display = STORAGE_FORMAT_CELSIUS;
-	m_mass_display = STORAGE_FORMAT_KG;
-	m_energy_display = STORAGE_FORMAT_JOULE;
-	m_angle_display = STORAGE_FORMAT_DEGREE;
-	m_velocity_display = STORAGE_FORMAT_KM | STORAGE_FORMAT_HOUR;
-	m_alt_velocity_display = STORAGE_FORMAT_M | STORAGE_FORMAT_MINUTE;
-	m_mass_area_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KG << 0x20) | STORAGE_FORMAT_M2;
-	m_intensity_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KILOWATT_SECOND << 0x20) | STORAGE_FORMAT_M;
-	m_power_display = STORAGE_FORMAT_KILOWATT_;
-	m_language_display = "en-ca";
+	m_profile.store(Retain(defaultProfile()), std::memory_order_release);
+}
+
+
+UnitConversion::UnitConversion(const UnitConversion& other)
+{
+	m_profile.store(Retain(other.Snapshot()), std::memory_order_release);
+}
+
+
+UnitConversion& UnitConversion::operator=(const UnitConversion& other) {
+	if (this != &other) {
+		const Profile& source = other.Snapshot();
+		Publish([&source](Profile& profile) { profile = source; });
+	}
+	return *this;
+}
+
+
+/// <summary>
+/// The kept profile equal to profile, adding a copy of it if there isn't one. Called with m_writeLock held (or
+/// from a constructor).
+/// </summary>
+const UnitConversion::Profile* UnitConversion::Retain(const Profile& profile) {
+	// switching between a handful of profiles is the common case, so look at the latest first
+	for (auto it = m_profiles.rbegin(); it != m_profiles.rend(); ++it)
+		if (**it == profile)
+			return it->get();
+	m_profiles.push_back(std::make_unique<const Profile>(profile));
+	return m_profiles.back().get();
+}
+
+
+/// <summary>
+/// Copy the current profile, apply update to the copy, and make it the current profile. Old profiles are kept
+/// (not freed) because lock free readers may still be using them, readers never touch a reference count.
+/// </summary>
+template<typename Func>
+const UnitConversion::Profile& UnitConversion::Publish(Func&& update) {
+	std::lock_guard<std::mutex> lock(m_writeLock);
+	const Profile* current = m_profile.load(std::memory_order_relaxed);
+	Profile profile = *current;
+	update(profile);
+	if (profile == *current)
+		return *current;
+	const Profile* published = Retain(profile);
+	m_profile.store(published, std::memory_order_release);
+	return *published;
 }
 
 
 void UnitConversion::ResetToDefaults() {
-	m_coordinate_display = STORAGE_COORDINATE_DEGREE;
-	m_distance_display = STORAGE_FORMAT_KM;
-	m_small_distance_display = STORAGE_FORMAT_M;
-	m_temp_display = STORAGE_FORMAT_CELSIUS;
-	m_small_measure_display = STORAGE_FORMAT_MM;
-	m_velocity_display = STORAGE_FORMAT_KM | STORAGE_FORMAT_HOUR;
-	m_alt_distance_display = STORAGE_FORMAT_M;
-	m_area_display = STORAGE_FORMAT_HECTARE;
-	m_alt_velocity_display = STORAGE_FORMAT_M | STORAGE_FORMAT_MINUTE;
-	m_mass_area_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KG << 0x20) | STORAGE_FORMAT_M2;
-	m_intensity_display = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KILOWATT_SECOND << 0x20) | STORAGE_FORMAT_M;
-	m_power_display = STORAGE_FORMAT_KILOWATT_;
-
-	m_volume_display = STORAGE_FORMAT_M3;
-	m_mass_display = STORAGE_FORMAT_KG;
-	m_energy_display = STORAGE_FORMAT_JOULE;
-	m_angle_display = STORAGE_COORDINATE_DEGREE;
+	Publish([](Profile& profile) {
+		std::string_view language = profile.language_display;
+		profile = defaultProfile();
+		profile.language_display = language;
+		profile.angle_display = STORAGE_COORDINATE_DEGREE;
+	});
 }
 
 
@@ -77,105 +130,105 @@ void UnitConversion::SaveToIniFile(const TCHAR *group_name) const
 
 UnitConvert::STORAGE_UNIT UnitConversion::SmallMeasureDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_DISTANCE_START) && (mode <= STORAGE_DISTANCE_END))
-		m_small_measure_display = mode;
+		return Publish([mode](Profile& profile) { profile.small_measure_display = mode; }).small_measure_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_small_measure_display;
+	return Snapshot().small_measure_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::SmallDistanceDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_DISTANCE_START) && (mode <= STORAGE_DISTANCE_END))
-		m_small_distance_display = mode;
+		return Publish([mode](Profile& profile) { profile.small_distance_display = mode; }).small_distance_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_small_distance_display;
+	return Snapshot().small_distance_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::DistanceDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_DISTANCE_START) && (mode <= STORAGE_DISTANCE_END))
-		m_distance_display = mode;
+		return Publish([mode](Profile& profile) { profile.distance_display = mode; }).distance_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_distance_display;
+	return Snapshot().distance_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::AltDistanceDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_DISTANCE_START) && (mode <= STORAGE_DISTANCE_END))
-		m_alt_distance_display = mode;
+		return Publish([mode](Profile& profile) { profile.alt_distance_display = mode; }).alt_distance_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_alt_distance_display;
+	return Snapshot().alt_distance_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::CoordinateDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_COORDINATE_START) && (mode <= STORAGE_COORDINATE_END))
-		m_coordinate_display = mode;
+		return Publish([mode](Profile& profile) { profile.coordinate_display = mode; }).coordinate_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_coordinate_display;
+	return Snapshot().coordinate_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::VelocityDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if (((mode & 0x00ff) >= STORAGE_DISTANCE_START) && ((mode & 0x00ff) <= STORAGE_DISTANCE_END))
-		m_velocity_display = mode;
+		return Publish([mode](Profile& profile) { profile.velocity_display = mode; }).velocity_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_velocity_display;
+	return Snapshot().velocity_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::AltVelocityDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if (((mode & 0x00ff) >= STORAGE_DISTANCE_START) && ((mode & 0x00ff) <= STORAGE_DISTANCE_END))
-		m_alt_velocity_display = mode;
+		return Publish([mode](Profile& profile) { profile.alt_velocity_display = mode; }).alt_velocity_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_alt_velocity_display;
+	return Snapshot().alt_velocity_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::AreaDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_AREA_START) && (mode <= STORAGE_AREA_END))
-		m_area_display = mode;
+		return Publish([mode](Profile& profile) { profile.area_display = mode; }).area_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_area_display;
+	return Snapshot().area_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::VolumeDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_VOLUME_START) && (mode <= STORAGE_VOLUME_END))
-		m_volume_display = mode;
+		return Publish([mode](Profile& profile) { profile.volume_display = mode; }).volume_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_volume_display;
+	return Snapshot().volume_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::TempDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_TEMP_START) && (mode <= STORAGE_TEMP_END))
-		m_temp_display = mode;
+		return Publish([mode](Profile& profile) { profile.temp_display = mode; }).temp_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_temp_display;
+	return Snapshot().temp_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::MassDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_MASS_START) && (mode <= STORAGE_MASS_END))
-		m_mass_display = mode;
+		return Publish([mode](Profile& profile) { profile.mass_display = mode; }).mass_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_mass_display;
+	return Snapshot().mass_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::MassAreaDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if (((mode >> 0x20) >= STORAGE_MASS_START) && ((mode >> 0x20) <= STORAGE_MASS_END))
-		m_mass_area_display = mode;
+		return Publish([mode](Profile& profile) { profile.mass_area_display = mode; }).mass_area_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_mass_area_display;
+	return Snapshot().mass_area_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::IntensityDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((((mode >> 0x20) & (~STORAGE_TIME_END)) >= STORAGE_ENERGY_START) && (((mode >> 0x20) & (~STORAGE_TIME_END)) <= STORAGE_ENERGY_END))
-		m_intensity_display = mode;
+		return Publish([mode](Profile& profile) { profile.intensity_display = mode; }).intensity_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_intensity_display;
+	return Snapshot().intensity_display;
 }
 
 
@@ -183,25 +236,25 @@ UnitConvert::STORAGE_UNIT UnitConversion::PowerDisplay(UnitConvert::STORAGE_UNIT
 	if (mode == UnitConvert::STORAGE_FORMAT_ERG_PER_SECOND || mode == UnitConvert::STORAGE_FORMAT_BTU_PER_SECOND ||
 		mode == UnitConvert::STORAGE_FORMAT_BTU_PER_HOUR || mode == STORAGE_FORMAT_WATT_ ||
 		mode == STORAGE_FORMAT_KILOWATT_ || mode == UnitConvert::STORAGE_FORMAT_MEGAWATT)
-		m_power_display = mode;
+		return Publish([mode](Profile& profile) { profile.power_display = mode; }).power_display;
 	else    AfxThrowNotSupportedException();	//asked for a conversion not supported
-	return m_power_display;
+	return Snapshot().power_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::EnergyDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if ((mode >= STORAGE_ENERGY_START) && (mode <= STORAGE_ENERGY_END))
-		m_energy_display = mode;
+		return Publish([mode](Profile& profile) { profile.energy_display = mode; }).energy_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_energy_display;
+	return Snapshot().energy_display;
 }
 
 
 UnitConvert::STORAGE_UNIT UnitConversion::AngleDisplay(UnitConvert::STORAGE_UNIT mode) {
 	if (((mode & 0x0000ffff) == STORAGE_FORMAT_ANGLE) /*&& ((mode & 0x00ff) <= STORAGE_ANGLE_END)*/)
-		m_angle_display = mode;
+		return Publish([mode](Profile& profile) { profile.angle_display = mode; }).angle_display;
 	else	AfxThrowNotSupportedException();	// asked for a conversion not supported
-	return m_angle_display;
+	return Snapshot().angle_display;
 }
 
 
@@ -215,34 +268,224 @@ double UnitConversion::ConvertUnit(double value, UnitConvert::STORAGE_UNIT from_
 }
 
 
+UnitConvert::STORAGE_UNIT UnitConversion::Profile::Display(Category category) const {
+	switch (category) {
+	case Category::SmallMeasure:	return small_measure_display;
+	case Category::SmallDistance:	return small_distance_display;
+	case Category::Distance:		return distance_display;
+	case Category::AltDistance:		return alt_distance_display;
+	case Category::Area:			return area_display;
+	case Category::Volume:			return volume_display;
+	case Category::Temp:			return temp_display;
+	case Category::Mass:			return mass_display;
+	case Category::MassArea:		return mass_area_display;
+	case Category::Energy:			return energy_display;
+	case Category::Angle:			return angle_display;
+	case Category::Velocity:		return velocity_display;
+	case Category::AltVelocity:		return alt_velocity_display;
+	case Category::Coordinate:		return coordinate_display;
+	case Category::Intensity:		return intensity_display;
+	case Category::Power:			return power_display;
+	default:						break;
+	}
+	AfxThrowNotSupportedException();	// asked for a category that doesn't exist
+	return 0;
+}
+
+
+bool UnitConversion::Profile::operator==(const Profile& other) const {
+	return (small_measure_display == other.small_measure_display) &&
+		(small_distance_display == other.small_distance_display) &&
+		(distance_display == other.distance_display) &&
+		(alt_distance_display == other.alt_distance_display) &&
+		(area_display == other.area_display) &&
+		(volume_display == other.volume_display) &&
+		(temp_display == other.temp_display) &&
+		(mass_display == other.mass_display) &&
+		(energy_display == other.energy_display) &&
+		(angle_display == other.angle_display) &&
+		(velocity_display == other.velocity_display) &&
+		(alt_velocity_display == other.alt_velocity_display) &&
+		(coordinate_display == other.coordinate_display) &&
+		(intensity_display == other.intensity_display) &&
+		(mass_area_display == other.mass_area_display) &&
+		(power_display == other.power_display) &&
+		(language_display == other.language_display);
+}
+
+
+namespace
+{
+	/// <summary>
+	/// How to convert between a pair of formats. Most conversions are to = from * scale + offset, which
+	/// can be applied to a whole column without going through convertUnit for every value.
+	/// </summary>
+	struct ConversionPlan
+	{
+		double scale, offset;
+		bool affine;
+	};
+
+	struct ConversionKey
+	{
+		UnitConvert::STORAGE_UNIT from, to;
+
+		bool operator==(const ConversionKey& other) const noexcept { return from == other.from && to == other.to; }
+	};
+
+	struct ConversionKeyHash
+	{
+		std::size_t operator()(const ConversionKey& key) const noexcept {
+			return std::hash<UnitConvert::STORAGE_UNIT>()(key.from) ^ (std::hash<UnitConvert::STORAGE_UNIT>()(key.to) * 0x9e3779b97f4a7c15ULL);
+		}
+	};
+
+	ConversionPlan buildPlan(UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format)
+	{
+		ConversionPlan plan;
+		plan.offset = UnitConvert::convertUnit(0.0, to_format, from_format);
+		plan.scale = UnitConvert::convertUnit(1.0, to_format, from_format) - plan.offset;
+		plan.affine = std::isfinite(plan.scale) && std::isfinite(plan.offset);
+
+		// check the line through 0 and 1 against values on both sides and well outside the range of an angle
+		static const double probes[] = { -12345.678, -1000.0, -2.5, 0.1, 7.0, 400.0, 98765.4321 };
+		for (std::size_t i = 0; plan.affine && (i < sizeof(probes) / sizeof(probes[0])); i++) {
+			double expected = UnitConvert::convertUnit(probes[i], to_format, from_format);
+			double actual = probes[i] * plan.scale + plan.offset;
+			if (!(fabs(actual - expected) <= (1e-12 * std::max(1.0, fabs(expected)))))
+				plan.affine = false;
+		}
+		return plan;
+	}
+
+	ConversionPlan lookupPlan(UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format)
+	{
+		static std::unordered_map<ConversionKey, ConversionPlan, ConversionKeyHash> s_plans;
+		static std::shared_mutex s_lock;
+
+		ConversionKey key{ from_format, to_format };
+		{
+			std::shared_lock<std::shared_mutex> lock(s_lock);
+			auto it = s_plans.find(key);
+			if (it != s_plans.end())
+				return it->second;
+		}
+		ConversionPlan plan = buildPlan(from_format, to_format);
+		std::unique_lock<std::shared_mutex> lock(s_lock);
+		return s_plans.emplace(key, plan).first->second;
+	}
+
+	void applyPlan(const ConversionPlan& plan, const double* in, double* out, std::size_t count, UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format)
+	{
+		if (plan.affine) {
+			const double scale = plan.scale, offset = plan.offset;
+			for (std::size_t i = 0; i < count; i++)
+				out[i] = in[i] * scale + offset;
+		}
+		else {
+			for (std::size_t i = 0; i < count; i++)
+				out[i] = UnitConvert::convertUnit(in[i], to_format, from_format);
+		}
+	}
+}
+
+
+void UnitConversion::ConvertUnit(const double* in, double* out, std::size_t count, UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format) {
+	if (!count)
+		return;
+	if (from_format == to_format) {
+		if (in != out)
+			std::copy(in, in + count, out);
+		return;
+	}
+	applyPlan(lookupPlan(from_format, to_format), in, out, count, from_format, to_format);
+}
+
+
+void UnitConversion::ConvertColumns(const Column* columns, std::size_t column_count, std::size_t row_count) const {
+	if (!column_count || !row_count)
+		return;
+
+	// resolve the display formats and plans up front so the workers only touch the data, all from one
+	// snapshot so a concurrent profile change can't leave the table converted to a mix of formats
+	const Profile& profile = Snapshot();
+	std::vector<UnitConvert::STORAGE_UNIT> display(column_count);
+	std::vector<ConversionPlan> plans(column_count);
+	for (std::size_t i = 0; i < column_count; i++) {
+		display[i] = profile.Display(columns[i].category);
+		if (columns[i].storage == display[i])
+			plans[i] = { 1.0, 0.0, true };
+		else
+			plans[i] = lookupPlan(columns[i].storage, display[i]);
+	}
+
+	std::atomic<std::size_t> next(0);
+	auto worker = [&]() {
+		std::size_t i;
+		while ((i = next.fetch_add(1, std::memory_order_relaxed)) < column_count) {
+			const Column& column = columns[i];
+			if ((column.storage == display[i]) && (column.in == column.out))
+				continue;
+			applyPlan(plans[i], column.in, column.out, row_count, column.storage, display[i]);
+		}
+	};
+
+	// not worth starting threads for small tables
+	constexpr std::size_t parallel_threshold = 1 << 16;
+	std::size_t thread_count = 1;
+	if ((column_count > 1) && (column_count * row_count >= parallel_threshold))
+		thread_count = std::min<std::size_t>(column_count, std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	for (std::size_t i = 1; i < thread_count; i++) {
+		try {
+			threads.emplace_back(worker);
+		}
+		catch (std::system_error&) {
+			// out of threads, the columns are handed out one at a time so this thread and the ones already
+			// started pick up the rest
+			break;
+		}
+	}
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+
 std::string UnitConversion::UnitName(UnitConvert::STORAGE_UNIT format, bool short_format) {
-	return UnitConvert::UnitName(format, short_format); 
+	return std::string(UnitConvert::UnitNameView(format, short_format));
 }
 
 
 std::string_view UnitConversion::DisplayLanguage() const {
-	return m_language_display;
+	return Snapshot().language_display;
 }
 
 
 bool UnitConversion::SetDisplayLanguage(const char* language) {
-	m_language_display = "";
+	std::string_view language_display = "";
 	if (boost::iequals(language, "en-us"))
-		m_language_display = "en-us";
+		language_display = "en-us";
 	if (boost::iequals(language, "en-ca"))
-		m_language_display = "en-ca";
+		language_display = "en-ca";
 	if (boost::iequals(language, "fr-ca"))
-		m_language_display = "fr-ca";
-	return strlen(m_language_display.data()) > 0;
+		language_display = "fr-ca";
+	Publish([language_display](Profile& profile) { profile.language_display = language_display; });
+	return !language_display.empty();
 }
 
 
 std::string_view UnitConversion::DisplayPrimaryLanguage() const {
-	if ((m_language_display[0] == 'e') &&
-		(m_language_display[1] == 'n'))
+	std::string_view language_display = Snapshot().language_display;
+	if (language_display.size() < 2)
+		return "";
+	if ((language_display[0] == 'e') &&
+		(language_display[1] == 'n'))
 		return "en";
-	if ((m_language_display[0] == 'f') &&
-		(m_language_display[1] == 'r'))
+	if ((language_display[0] == 'f') &&
+		(language_display[1] == 'r'))
 		return "fr";
 	return "";
 }
@@ -18,6 +18,11 @@
 
 #include "intel_check.h"
 #include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 #include "types.h"
 #include "convert.h"
 #include "ConversionFactors.h"
@@ -60,6 +65,96 @@ double COMPASS_TO_CARTESIAN_RADIAN(const double X) {
 }
 
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HSS_CONVERT_SSE2 1
+
+// 2 lanes of UnitConvert::normalizeAngleRadian. Lanes beyond ANGLE_REDUCE_LIMIT turns (or NaN) are flagged
+// in overflow so the caller can redo them with the scalar version.
+static inline __m128d normalizeAngleRadian_sse2(__m128d x, int* overflow) noexcept
+{
+	const __m128d two_pi = _mm_set1_pd(UnitConvert::ANGLE_TWO_PI);
+	const __m128d q = _mm_mul_pd(x, _mm_set1_pd(UnitConvert::ANGLE_ONE_OVER_TWO_PI));
+	const __m128d abs_q = _mm_andnot_pd(_mm_set1_pd(-0.0), q);
+	*overflow = _mm_movemask_pd(_mm_cmpnlt_pd(abs_q, _mm_set1_pd(UnitConvert::ANGLE_REDUCE_LIMIT)));
+	const __m128d n = _mm_cvtepi32_pd(_mm_cvttpd_epi32(q));
+	__m128d r = _mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(UnitConvert::ANGLE_TWO_PI_HI)));
+	r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(UnitConvert::ANGLE_TWO_PI_LO)));
+	r = _mm_add_pd(r, _mm_and_pd(_mm_cmplt_pd(r, _mm_setzero_pd()), two_pi));
+	r = _mm_sub_pd(r, _mm_and_pd(_mm_cmpge_pd(r, two_pi), two_pi));
+	return r;
+}
+#endif
+
+
+template<bool reverse>
+static void normalizeAngleRadianArray(const double* in, double* out, std::size_t count) noexcept
+{
+	std::size_t i = 0;
+#ifdef HSS_CONVERT_SSE2
+	const __m128d two_half_pi = _mm_set1_pd(UnitConvert::ANGLE_TWO_HALF_PI);
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(in + i);
+		if constexpr (reverse)
+			x = _mm_sub_pd(two_half_pi, x);
+		int overflow;
+		_mm_storeu_pd(out + i, normalizeAngleRadian_sse2(x, &overflow));
+		if (overflow)
+		{
+			for (std::size_t j = 0; j < 2; j++)
+				if (overflow & (1 << j))
+					out[i + j] = reverse ? UnitConvert::cartesianToCompassRadian(in[i + j]) : UnitConvert::normalizeAngleRadian(in[i + j]);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = reverse ? UnitConvert::cartesianToCompassRadian(in[i]) : UnitConvert::normalizeAngleRadian(in[i]);
+}
+
+
+static void scaleArray(const double* in, double* out, std::size_t count, double scale) noexcept
+{
+	std::size_t i = 0;
+#ifdef HSS_CONVERT_SSE2
+	const __m128d s = _mm_set1_pd(scale);
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(in + i), s));
+#endif
+	for (; i < count; i++)
+		out[i] = in[i] * scale;
+}
+
+
+void UnitConvert::degreeToRadian(const double* in, double* out, std::size_t count) noexcept
+{
+	scaleArray(in, out, count, ANGLE_DEGREE_TO_RADIAN);
+}
+
+
+void UnitConvert::radianToDegree(const double* in, double* out, std::size_t count) noexcept
+{
+	scaleArray(in, out, count, ANGLE_RADIAN_TO_DEGREE);
+}
+
+
+void UnitConvert::normalizeAngleRadian(const double* in, double* out, std::size_t count) noexcept
+{
+	normalizeAngleRadianArray<false>(in, out, count);
+}
+
+
+void UnitConvert::cartesianToCompassRadian(const double* in, double* out, std::size_t count) noexcept
+{
+	normalizeAngleRadianArray<true>(in, out, count);
+}
+
+
+void UnitConvert::compassToCartesianRadian(const double* in, double* out, std::size_t count) noexcept
+{
+	normalizeAngleRadianArray<true>(in, out, count);
+}
+
 float UnitConvert::convertUnit(float value, STORAGE_UNIT to_format, STORAGE_UNIT from_format)
 {
 	return (float)convertUnit((double)value, to_format, from_format);
@@ -487,6 +582,7 @@ double UnitConvert::convertUnit(tstring value, STORAGE_UNIT to_format, int* ierr
 
 double UnitConvert::convertUnit(tstring value, STORAGE_UNIT to_format, STORAGE_UNIT from_format, int* ierr)
 {
+#ifdef UNICODE
 	tstring valueInLowerCase;
 	tstring unitsInLowerCase;
 	double val;
@@ -533,6 +629,84 @@ double UnitConvert::convertUnit(tstring value, STORAGE_UNIT to_format, STORAGE_U
 	if (ierr)
 		*ierr = 1;
 	return 0;
+#else
+	auto result = tryConvertUnit(value, to_format, from_format);
+	if (ierr)
+		*ierr = result.ok() ? 0 : 1;
+	return result.value;
+#endif
+}
+
+
+static inline bool isUnitSpace(char c) noexcept
+{
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+
+UnitConvert::ConvertResult UnitConvert::parseUnit(std::string_view value, STORAGE_UNIT from_format)
+{
+	ConvertResult result{ 0.0, from_format, ConvertError::NONE };
+
+	const char* first = value.data();
+	const char* last = first + value.length();
+	while ((first < last) && isUnitSpace(*first))
+		first++;
+	while ((last > first) && isUnitSpace(*(last - 1)))
+		last--;
+	if (first == last)
+	{
+		result.error = ConvertError::NO_VALUE;
+		return result;
+	}
+
+	// std::from_chars doesn't accept a leading '+', strip it ourselves but don't allow "+-5"
+	const char* number = first;
+	if ((*number == '+') && ((number + 1) < last) && (*(number + 1) != '-'))
+		number++;
+
+	double val;
+	auto [ptr, ec] = std::from_chars(number, last, val, std::chars_format::general);
+	if (ec != std::errc())
+	{
+		result.error = ConvertError::INVALID_VALUE;
+		return result;
+	}
+
+	if (from_format == 0)
+	{
+		while ((ptr < last) && isUnitSpace(*ptr))
+			ptr++;
+		// UnitFormat will copy the name into a 40 character buffer, and needs it NULL terminated, so do the
+		// same here on the stack rather than building a string
+		TCHAR unit[40];
+		const size_t length = last - ptr;
+		if ((length == 0) || (length >= (sizeof(unit) / sizeof(unit[0]))))
+		{
+			result.error = ConvertError::UNKNOWN_UNIT;
+			return result;
+		}
+		std::copy(ptr, last, unit);
+		unit[length] = 0;
+		result.from_format = UnitFormat((STORAGE_UNIT)0, unit);
+		if (result.from_format == 0)
+		{
+			result.error = ConvertError::UNKNOWN_UNIT;
+			return result;
+		}
+	}
+
+	result.value = val;
+	return result;
+}
+
+
+UnitConvert::ConvertResult UnitConvert::tryConvertUnit(std::string_view value, STORAGE_UNIT to_format, STORAGE_UNIT from_format)
+{
+	auto result = parseUnit(value, from_format);
+	if (result.ok())
+		result.value = convertUnit(result.value, to_format, result.from_format);
+	return result;
 }
 
 
@@ -1232,3 +1406,24 @@ tstring UnitConvert::UnitName(STORAGE_UNIT format, bool short_format)
 	}
 	return _T("");
 }
+
+
+std::string_view UnitConvert::UnitNameView(STORAGE_UNIT format, bool short_format)
+{
+	// the map is node based so the strings, and views into them, never move once they're inserted
+	static std::unordered_map<STORAGE_UNIT, std::string> s_names[2];
+	static std::shared_mutex s_mutex;
+
+	auto& names = s_names[short_format ? 1 : 0];
+	{
+		std::shared_lock<std::shared_mutex> lock(s_mutex);
+		auto it = names.find(format);
+		if (it != names.end())
+			return it->second;
+	}
+
+	std::string name = toStdString(UnitName(format, short_format));
+	std::unique_lock<std::shared_mutex> lock(s_mutex);
+	auto [it, inserted] = names.emplace(format, std::move(name));
+	return it->second;
+}
@@ -0,0 +1,416 @@
+/**
+ * numeric_column.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intel_check.h"
+#include "numeric_column.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HSS_NUMERIC_COLUMN_SSE2 1
+#endif
+
+
+namespace
+{
+	// the size of a value in the tagged layout
+	constexpr std::size_t cellSize = 8;
+	// the packed size of each alternative of NumericVariant, std::monostate takes no space
+	constexpr std::size_t widths[] = { 0, 1, 1, 2, 4, 8, 1, 2, 4, 8, 4, 8 };
+	static_assert(std::size(widths) == std::variant_size_v<NumericVariant>);
+
+	template<std::size_t I>
+	using index_t = std::integral_constant<std::size_t, I>;
+
+	/// <summary>
+	/// Call func with the index of an alternative of NumericVariant as a compile time constant.
+	/// </summary>
+	template<typename Func>
+	auto dispatch(std::size_t index, Func&& func)
+	{
+		switch (index)
+		{
+		case 1:		return func(index_t<1>());
+		case 2:		return func(index_t<2>());
+		case 3:		return func(index_t<3>());
+		case 4:		return func(index_t<4>());
+		case 5:		return func(index_t<5>());
+		case 6:		return func(index_t<6>());
+		case 7:		return func(index_t<7>());
+		case 8:		return func(index_t<8>());
+		case 9:		return func(index_t<9>());
+		case 10:	return func(index_t<10>());
+		case 11:	return func(index_t<11>());
+		default:	return func(index_t<0>());
+		}
+	}
+
+	template<typename S>
+	S load(const std::uint8_t* in) noexcept
+	{
+		S value;
+		std::memcpy(&value, in, sizeof(S));
+		return value;
+	}
+
+#ifdef HSS_NUMERIC_COLUMN_SSE2
+	/// <summary>
+	/// Load 4 values that fit in a 32 bit integer, sign or zero extended to 32 bit lanes.
+	/// </summary>
+	template<typename S>
+	__m128i load4Int32(const std::uint8_t* in) noexcept
+	{
+		const __m128i zero = _mm_setzero_si128();
+		if constexpr (sizeof(S) == 4)
+			return _mm_loadu_si128((const __m128i*)in);
+		else if constexpr (sizeof(S) == 2)
+		{
+			__m128i v = _mm_loadl_epi64((const __m128i*)in);
+			if constexpr (std::is_signed_v<S>)
+				return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			else
+				return _mm_unpacklo_epi16(v, zero);
+		}
+		else
+		{
+			__m128i v = _mm_cvtsi32_si128(load<int>(in));
+			if constexpr (std::is_signed_v<S>)
+			{
+				v = _mm_unpacklo_epi8(v, v);
+				return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+			}
+			else
+				return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+		}
+	}
+
+	/// <summary>
+	/// 2 doubles rounded to integers the way detail::convertNumeric does, (int)(value + 0.5), in the low lanes.
+	/// Values outside of the range of an integer give INT_MIN, the same as the scalar cvttsd2si.
+	/// </summary>
+	inline __m128i roundToInt32(__m128d v) noexcept
+	{
+		return _mm_cvttpd_epi32(_mm_add_pd(v, _mm_set1_pd(0.5)));
+	}
+
+	/// <summary>
+	/// Convert as many values as can be done 4 at a time from in to out.
+	/// </summary>
+	/// <returns>The number of values converted, the rest are left for the scalar loop.</returns>
+	template<typename S, typename T>
+	std::size_t convertSse2(const std::uint8_t* in, T* out, std::size_t count) noexcept
+	{
+		constexpr bool smallInt = std::is_integral_v<S> && sizeof(S) <= 4;
+		std::size_t i = 0;
+		if constexpr (std::is_same_v<T, std::int32_t> && smallInt)
+		{
+			//a uint32 becomes an int32 by copying the bits
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_si128((__m128i*)(out + i), load4Int32<S>(in + i * sizeof(S)));
+		}
+		else if constexpr (std::is_same_v<T, std::int32_t> && std::is_integral_v<S>)
+		{
+			//64 bit integers are narrowed by keeping the low half
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i a = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(in + i * 8)), _MM_SHUFFLE(0, 0, 2, 0));
+				__m128i b = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(in + i * 8 + 16)), _MM_SHUFFLE(0, 0, 2, 0));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi64(a, b));
+			}
+		}
+		else if constexpr (std::is_same_v<T, std::int32_t> && std::is_same_v<S, double>)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i a = roundToInt32(_mm_loadu_pd((const double*)(in + i * 8)));
+				__m128i b = roundToInt32(_mm_loadu_pd((const double*)(in + i * 8 + 16)));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi64(a, b));
+			}
+		}
+		else if constexpr (std::is_same_v<T, std::int32_t> && std::is_same_v<S, float>)
+		{
+			//the 0.5 is added as a double, so widen first
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 v = _mm_loadu_ps((const float*)(in + i * 4));
+				__m128i a = roundToInt32(_mm_cvtps_pd(v));
+				__m128i b = roundToInt32(_mm_cvtps_pd(_mm_movehl_ps(v, v)));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi64(a, b));
+			}
+		}
+		else if constexpr (std::is_same_v<T, std::int64_t> && smallInt)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i v = load4Int32<S>(in + i * sizeof(S));
+				__m128i high = std::is_signed_v<S> ? _mm_srai_epi32(v, 31) : _mm_setzero_si128();
+				_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi32(v, high));
+				_mm_storeu_si128((__m128i*)(out + i + 2), _mm_unpackhi_epi32(v, high));
+			}
+		}
+		else if constexpr (std::is_same_v<T, double> && smallInt && !std::is_same_v<S, bool>)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i v = load4Int32<S>(in + i * sizeof(S));
+				if constexpr (std::is_same_v<S, std::uint32_t>)
+				{
+					//no unsigned conversion in SSE2, flip the sign bit and add it back as a double
+					const __m128d offset = _mm_set1_pd(2147483648.0);
+					v = _mm_xor_si128(v, _mm_set1_epi32(INT32_MIN));
+					_mm_storeu_pd(out + i, _mm_add_pd(_mm_cvtepi32_pd(v), offset));
+					_mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), offset));
+				}
+				else
+				{
+					_mm_storeu_pd(out + i, _mm_cvtepi32_pd(v));
+					_mm_storeu_pd(out + i + 2, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+				}
+			}
+		}
+		else if constexpr (std::is_same_v<T, double> && std::is_same_v<S, float>)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 v = _mm_loadu_ps((const float*)(in + i * 4));
+				_mm_storeu_pd(out + i, _mm_cvtps_pd(v));
+				_mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+			}
+		}
+		else if constexpr (std::is_same_v<T, float> && smallInt && !std::is_same_v<S, bool> && !std::is_same_v<S, std::uint32_t>)
+		{
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_ps(out + i, _mm_cvtepi32_ps(load4Int32<S>(in + i * sizeof(S))));
+		}
+		else if constexpr (std::is_same_v<T, float> && std::is_same_v<S, double>)
+		{
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 a = _mm_cvtpd_ps(_mm_loadu_pd((const double*)(in + i * 8)));
+				__m128 b = _mm_cvtpd_ps(_mm_loadu_pd((const double*)(in + i * 8 + 16)));
+				_mm_storeu_ps(out + i, _mm_movelh_ps(a, b));
+			}
+		}
+		return i;
+	}
+#endif
+
+	/// <summary>
+	/// Convert count packed values of type S.
+	/// </summary>
+	template<typename S, typename T>
+	bool convertTyped(const std::uint8_t* in, T* out, std::size_t count) noexcept
+	{
+		if constexpr (std::is_same_v<S, std::monostate>)
+		{
+			std::fill(out, out + count, (T)0);
+			return count == 0;
+		}
+		else if constexpr (std::is_same_v<S, T>)
+		{
+			std::memcpy(out, in, count * sizeof(T));
+			return true;
+		}
+		else
+		{
+			std::size_t i = 0;
+#ifdef HSS_NUMERIC_COLUMN_SSE2
+			i = convertSse2<S>(in, out, count);
+#endif
+			bool converted = true;
+			for (; i < count; i++)
+			{
+				if (!detail::convertNumeric(load<S>(in + i * sizeof(S)), out + i))
+				{
+					out[i] = 0;
+					converted = false;
+				}
+			}
+			return converted;
+		}
+	}
+
+	/// <summary>
+	/// Convert count values from the tagged layout.
+	/// </summary>
+	template<typename T>
+	bool convertTagged(const std::uint8_t* tags, const std::uint8_t* in, T* out, std::size_t count) noexcept
+	{
+		bool converted = true;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			bool valid = dispatch(tags[i], [&](auto index) {
+				using S = std::variant_alternative_t<decltype(index)::value, NumericVariant>;
+				if constexpr (std::is_same_v<S, std::monostate>)
+					return false;
+				else
+					return detail::convertNumeric(load<S>(in + i * cellSize), out + i);
+			});
+			if (!valid)
+			{
+				out[i] = 0;
+				converted = false;
+			}
+		}
+		return converted;
+	}
+}
+
+
+NumericColumn::NumericColumn(const NumericVariant* values, std::size_t count)
+{
+	if (!count)
+		return;
+	std::size_t index = values[0].index();
+	m_type = std::any_of(values + 1, values + count, [index](const NumericVariant& v) { return v.index() != index; }) ? mixed : index;
+	reserve(count);
+	for (std::size_t i = 0; i < count; i++)
+		push_back(values[i]);
+}
+
+
+void NumericColumn::reserve(std::size_t count)
+{
+	if (m_type == mixed)
+	{
+		m_tags.reserve(count);
+		m_bytes.reserve(count * cellSize);
+	}
+	else
+		m_bytes.reserve(count * widths[m_type]);
+}
+
+
+void NumericColumn::clear() noexcept
+{
+	m_size = 0;
+	m_type = 0;
+	m_bytes.clear();
+	m_tags.clear();
+}
+
+
+void NumericColumn::push_back(const NumericVariant& value)
+{
+	std::size_t index = value.index();
+	//an empty column takes the type of its first value
+	if (!m_size && m_type != mixed)
+		m_type = index;
+	else if (m_type != index && m_type != mixed)
+		makeTagged();
+
+	std::size_t width = widths[index];
+	if (m_type == mixed)
+	{
+		m_tags.push_back((std::uint8_t)index);
+		width = cellSize;
+	}
+	std::size_t offset = m_bytes.size();
+	m_bytes.resize(offset + width);
+	dispatch(index, [&](auto i) {
+		if constexpr (decltype(i)::value != 0)
+		{
+			auto v = *std::get_if<decltype(i)::value>(&value);
+			std::memcpy(m_bytes.data() + offset, &v, sizeof(v));
+		}
+	});
+	m_size++;
+}
+
+
+NumericVariant NumericColumn::operator[](std::size_t index) const noexcept
+{
+	std::size_t type = m_type;
+	const std::uint8_t* in;
+	if (m_type == mixed)
+	{
+		type = m_tags[index];
+		in = m_bytes.data() + index * cellSize;
+	}
+	else
+		in = m_bytes.data() + index * widths[m_type];
+	return dispatch(type, [in](auto i) {
+		if constexpr (decltype(i)::value == 0)
+			return NumericVariant();
+		else
+			return NumericVariant(std::in_place_index<decltype(i)::value>, load<std::variant_alternative_t<decltype(i)::value, NumericVariant>>(in));
+	});
+}
+
+
+void NumericColumn::makeTagged()
+{
+	std::vector<std::uint8_t> bytes(m_size * cellSize);
+	std::size_t width = widths[m_type];
+	for (std::size_t i = 0; width && i < m_size; i++)
+		std::memcpy(bytes.data() + i * cellSize, m_bytes.data() + i * width, width);
+	m_tags.assign(m_size, (std::uint8_t)m_type);
+	m_bytes = std::move(bytes);
+	m_type = mixed;
+}
+
+
+template<typename T>
+bool NumericColumn::convert(T* out, std::size_t first, std::size_t count) const noexcept
+{
+	if (first > m_size || count > m_size - first)
+	{
+		weak_assert(false);
+		return false;
+	}
+
+	bool converted;
+	if (m_type == mixed)
+		converted = convertTagged(m_tags.data() + first, m_bytes.data() + first * cellSize, out, count);
+	else
+	{
+		converted = dispatch(m_type, [&](auto index) {
+			using S = std::variant_alternative_t<decltype(index)::value, NumericVariant>;
+			return convertTyped<S>(m_bytes.data() + first * widths[m_type], out, count);
+		});
+	}
+	weak_assert(converted);
+	return converted;
+}
+
+
+bool NumericColumn::toDouble(double* out, std::size_t first, std::size_t count) const noexcept
+{
+	return convert(out, first, count);
+}
+
+
+bool NumericColumn::toFloat(float* out, std::size_t first, std::size_t count) const noexcept
+{
+	return convert(out, first, count);
+}
+
+
+bool NumericColumn::toInt32(std::int32_t* out, std::size_t first, std::size_t count) const noexcept
+{
+	return convert(out, first, count);
+}
+
+
+bool NumericColumn::toInt64(std::int64_t* out, std::size_t first, std::size_t count) const noexcept
+{
+	return convert(out, first, count);
+}
@@ -5,54 +5,675 @@
  * This code is released under the terms of the MIT License
 */
 
+#if defined(__linux__) && !defined(WFMO) && !defined(PEVENTS_NO_FUTEX)
+#define PEVENTS_FUTEX 1
+#endif
+
 #ifndef _WIN32
 
+#include "types.h"
+#include "pevents.h"
+#include <atomic>
+#include <sched.h>
+#include <thread>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+#ifdef PEVENTS_INSTRUMENTATION
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#endif
+
+namespace neosmart
+{
+	//Timeouts are carried internally as nanoseconds, this one means wait forever
+	static const uint64_t InfiniteTimeout = UINT64_MAX;
+
+	static uint64_t TimeoutNanoseconds(uint64_t milliseconds)
+	{
+		//Anything that doesn't fit in 64 bits of nanoseconds (~584 years) may as well be forever
+		if (milliseconds == -1ul || milliseconds > InfiniteTimeout / (1000 * 1000))
+		{
+			return InfiniteTimeout;
+		}
+		return milliseconds * 1000 * 1000;
+	}
+
+	static uint64_t TimeoutNanoseconds(std::chrono::nanoseconds timeout)
+	{
+		if (timeout == std::chrono::nanoseconds::max())
+		{
+			return InfiniteTimeout;
+		}
+		return timeout.count() > 0 ? (uint64_t)timeout.count() : 0;
+	}
+
+	//An absolute deadline nanoseconds from now, measured on the given clock
+	static timespec TimeoutDeadline(clockid_t clock, uint64_t nanoseconds)
+	{
+		timespec ts;
+		clock_gettime(clock, &ts);
+
+		uint64_t seconds = nanoseconds / 1000 / 1000 / 1000;
+		nanoseconds = ((uint64_t)ts.tv_nsec) + nanoseconds - seconds * 1000 * 1000 * 1000;
+		ts.tv_sec += (time_t)(seconds + nanoseconds / 1000 / 1000 / 1000);
+		ts.tv_nsec = (long)(nanoseconds % (1000 * 1000 * 1000));
+		return ts;
+	}
+
+	static uint64_t MonotonicNanoseconds()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000 + (uint64_t)ts.tv_nsec;
+	}
+
+	static inline void CpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	//The adaptive part of a wait, shared by both implementations. Spins with a pause instruction, then yields
+	//the processor, calling acquire() after each step until it succeeds or the budget runs out. Time spent here
+	//comes off the caller's timeout. Returns true if the event was acquired without blocking
+	template<typename Acquire>
+	static bool AdaptiveWait(const neosmart_event_attr_t &attributes, uint64_t &nanoseconds,
+		std::atomic<uint64_t> &spins, std::atomic<uint64_t> &yields, Acquire &&acquire)
+	{
+		if (attributes.SpinCount == 0 && attributes.YieldCount == 0)
+		{
+			return false;
+		}
+
+		//With one processor nothing can signal the event while we spin, so go straight to yielding
+		static const bool multiprocessor = std::thread::hardware_concurrency() > 1;
+
+		uint64_t start = nanoseconds != InfiniteTimeout ? MonotonicNanoseconds() : 0;
+		auto expired = [&]()
+		{
+			return nanoseconds != InfiniteTimeout && MonotonicNanoseconds() - start >= nanoseconds;
+		};
+
+		for (uint32_t i = 0; multiprocessor && i < attributes.SpinCount; ++i)
+		{
+			CpuRelax();
+			if (acquire())
+			{
+				spins.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			//Reading the clock costs far more than a pause so only check the timeout now and then
+			if ((i & 0xff) == 0xff && expired())
+			{
+				break;
+			}
+		}
+
+		for (uint32_t i = 0; i < attributes.YieldCount && !expired(); ++i)
+		{
+			sched_yield();
+			if (acquire())
+			{
+				yields.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		if (nanoseconds != InfiniteTimeout)
+		{
+			uint64_t elapsed = MonotonicNanoseconds() - start;
+			nanoseconds = elapsed < nanoseconds ? nanoseconds - elapsed : 0;
+		}
+		return false;
+	}
+
+#ifdef __linux__
+	static int CreatePollFd()
+	{
+		return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	//Make an event's eventfd readable or not, its counter only ever holds 0 or 1
+	static void SignalPollFd(int fd, bool signaled)
+	{
+		uint64_t value = 1;
+		ssize_t result = signaled ? write(fd, &value, sizeof(value)) : read(fd, &value, sizeof(value));
+		weak_assert(result == sizeof(value));
+		(void)result;
+	}
+#endif
+
+	neosmart_event_t CreateEvent(bool manualReset, bool initialState)
+	{
+		neosmart_event_attr_t attributes;
+		attributes.ManualReset = manualReset;
+		attributes.InitialState = initialState;
+		return CreateEvent(attributes);
+	}
+
+	neosmart_event_t CreateEvent(bool manualReset, bool initialState, const char *name)
+	{
+		neosmart_event_attr_t attributes;
+		attributes.ManualReset = manualReset;
+		attributes.InitialState = initialState;
+		attributes.Name = name;
+		return CreateEvent(attributes);
+	}
+
+#ifdef PEVENTS_INSTRUMENTATION
+	//Counters kept for every event, and the links of the registry of live events
+	struct neosmart_event_instrumentation_t_
+	{
+		neosmart_event_t Event = nullptr;
+		std::string Name;
+		std::atomic<uint64_t> Sets{ 0 };
+		std::atomic<uint64_t> Waits{ 0 };
+		std::atomic<uint64_t> Timeouts{ 0 };
+		std::atomic<uint32_t> Waiters{ 0 };
+		std::atomic<uint32_t> PeakWaiters{ 0 };
+		std::atomic<uint64_t> TotalWaitNanoseconds{ 0 };
+		std::atomic<uint64_t> MaxWaitNanoseconds{ 0 };
+		std::atomic<uint64_t> WaitHistogram[EventWaitHistogramBuckets] = {};
+		neosmart_event_instrumentation_t_ *Prev = nullptr;
+		neosmart_event_instrumentation_t_ *Next = nullptr;
+	};
+
+	//Function statics so that events created during static initialization can register
+	static std::mutex &RegistryMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static neosmart_event_instrumentation_t_ *&RegistryHead()
+	{
+		static neosmart_event_instrumentation_t_ *head = nullptr;
+		return head;
+	}
+
+	static void RegisterEvent(neosmart_event_instrumentation_t_ &instrumentation, neosmart_event_t event, const char *name)
+	{
+		instrumentation.Event = event;
+		if (name)
+		{
+			instrumentation.Name = name;
+		}
+
+		std::lock_guard<std::mutex> lock(RegistryMutex());
+		instrumentation.Next = RegistryHead();
+		if (instrumentation.Next)
+		{
+			instrumentation.Next->Prev = &instrumentation;
+		}
+		RegistryHead() = &instrumentation;
+	}
+
+	static void UnregisterEvent(neosmart_event_instrumentation_t_ &instrumentation)
+	{
+		std::lock_guard<std::mutex> lock(RegistryMutex());
+		if (instrumentation.Prev)
+		{
+			instrumentation.Prev->Next = instrumentation.Next;
+		}
+		else
+		{
+			RegistryHead() = instrumentation.Next;
+		}
+		if (instrumentation.Next)
+		{
+			instrumentation.Next->Prev = instrumentation.Prev;
+		}
+	}
+
+	template<typename T>
+	static void AtomicMax(std::atomic<T> &value, T candidate)
+	{
+		T current = value.load(std::memory_order_relaxed);
+		while (current < candidate && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	//Bucket 0 holds waits under a microsecond, bucket i those from 2^(i-1) up to 2^i microseconds
+	static int WaitHistogramBucket(uint64_t nanoseconds)
+	{
+		uint64_t microseconds = nanoseconds / 1000;
+		int bucket = 0;
+		while (microseconds && bucket < EventWaitHistogramBuckets - 1)
+		{
+			microseconds >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	//Count and time one call to WaitForEvent
+	template<typename Wait>
+	static int InstrumentWait(neosmart_event_instrumentation_t_ &instrumentation, Wait &&wait)
+	{
+		AtomicMax(instrumentation.PeakWaiters, instrumentation.Waiters.fetch_add(1, std::memory_order_relaxed) + 1);
+		uint64_t start = MonotonicNanoseconds();
+
+		int result = wait();
+
+		uint64_t elapsed = MonotonicNanoseconds() - start;
+		instrumentation.Waiters.fetch_sub(1, std::memory_order_relaxed);
+		instrumentation.Waits.fetch_add(1, std::memory_order_relaxed);
+		if (result == WAIT_TIMEOUT)
+		{
+			instrumentation.Timeouts.fetch_add(1, std::memory_order_relaxed);
+		}
+		instrumentation.TotalWaitNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+		AtomicMax(instrumentation.MaxWaitNanoseconds, elapsed);
+		instrumentation.WaitHistogram[WaitHistogramBucket(elapsed)].fetch_add(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	static void ReadInstrumentation(const neosmart_event_instrumentation_t_ &instrumentation, neosmart_event_info_t &info)
+	{
+		info.Name = instrumentation.Name;
+		info.Sets = instrumentation.Sets.load(std::memory_order_relaxed);
+		info.Waits = instrumentation.Waits.load(std::memory_order_relaxed);
+		info.Timeouts = instrumentation.Timeouts.load(std::memory_order_relaxed);
+		info.Waiters = instrumentation.Waiters.load(std::memory_order_relaxed);
+		info.PeakWaiters = instrumentation.PeakWaiters.load(std::memory_order_relaxed);
+		info.TotalWaitNanoseconds = instrumentation.TotalWaitNanoseconds.load(std::memory_order_relaxed);
+		info.MaxWaitNanoseconds = instrumentation.MaxWaitNanoseconds.load(std::memory_order_relaxed);
+		for (int i = 0; i < EventWaitHistogramBuckets; ++i)
+		{
+			info.WaitHistogram[i] = instrumentation.WaitHistogram[i].load(std::memory_order_relaxed);
+		}
+	}
+#endif
+} // namespace neosmart
+
+#endif
+
+#if !defined(_WIN32) && defined(PEVENTS_FUTEX)
+
+#include "types.h"
+#include "pevents.h"
+#include <atomic>
+#include <climits>
+#include <errno.h>
+#include <unistd.h>
+#include <mutex>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+namespace neosmart
+{
+	//The event state lives in a single 32 bit word that waiters sleep on with futex(2), so checking a
+	//signaled event is one atomic operation and setting an event nobody waits on makes no system call.
+	struct neosmart_event_t_
+	{
+		std::atomic<uint32_t> State;	//0 = unsignaled, 1 = signaled, also the futex word
+		std::atomic<uint32_t> Waiters;	//the number of threads that are, or are about to be, in FUTEX_WAIT
+		bool AutoReset;
+		neosmart_event_attr_t Attributes;
+		std::atomic<uint64_t> Spins{ 0 };
+		std::atomic<uint64_t> Yields{ 0 };
+		std::atomic<uint64_t> Blocks{ 0 };
+		//The eventfd from GetEventPollFd, -1 until someone asks for one. PollSignaled is what was last written
+		//to it, both are updated under PollMutex so the descriptor converges on State after each transition
+		std::atomic<int> PollFd{ -1 };
+		bool PollSignaled = false;
+		std::mutex PollMutex;
+#ifdef PEVENTS_INSTRUMENTATION
+		neosmart_event_instrumentation_t_ Instrumentation;
+#endif
+	};
+
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex requires a plain 32 bit word");
+
+	//Sleeps while *word == expected, until the absolute CLOCK_MONOTONIC deadline if one is given
+	static int FutexWait(std::atomic<uint32_t> *word, uint32_t expected, const timespec *deadline)
+	{
+		return (int)syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+	}
+
+	static void FutexWake(std::atomic<uint32_t> *word, int count)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+	}
+
+	static void SyncPollFd(neosmart_event_t event)
+	{
+		std::lock_guard<std::mutex> lock(event->PollMutex);
+		bool signaled = event->State.load(std::memory_order_seq_cst) != 0;
+		if (signaled != event->PollSignaled)
+		{
+			SignalPollFd(event->PollFd.load(std::memory_order_relaxed), signaled);
+			event->PollSignaled = signaled;
+		}
+	}
+
+	//Called after every change of State, costs a load unless the event has a descriptor
+	static inline void StateChanged(neosmart_event_t event)
+	{
+		if (event->PollFd.load(std::memory_order_seq_cst) != -1)
+		{
+			SyncPollFd(event);
+		}
+	}
+
+	//Try to take the event without blocking
+	static inline bool TryAcquire(neosmart_event_t event)
+	{
+		if (event->AutoReset)
+		{
+			uint32_t expected = 1;
+			if (event->State.compare_exchange_strong(expected, 0, std::memory_order_seq_cst))
+			{
+				StateChanged(event);
+				return true;
+			}
+			return false;
+		}
+		return event->State.load(std::memory_order_seq_cst) != 0;
+	}
+
+	neosmart_event_t CreateEvent(const neosmart_event_attr_t &attributes)
+	{
+		neosmart_event_t event = new neosmart_event_t_;
+		event->State.store(attributes.InitialState ? 1 : 0, std::memory_order_relaxed);
+		event->Waiters.store(0, std::memory_order_relaxed);
+		event->AutoReset = !attributes.ManualReset;
+		event->Attributes = attributes;
+		event->Attributes.Name = nullptr;
+#ifdef PEVENTS_INSTRUMENTATION
+		RegisterEvent(event->Instrumentation, event, attributes.Name);
+#endif
+		return event;
+	}
+
+	int DestroyEvent(neosmart_event_t event)
+	{
+#ifdef PEVENTS_INSTRUMENTATION
+		UnregisterEvent(event->Instrumentation);
+#endif
+		int fd = event->PollFd.load(std::memory_order_relaxed);
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		delete event;
+		return 0;
+	}
+
+	int GetEventPollFd(neosmart_event_t event)
+	{
+		int fd = event->PollFd.load(std::memory_order_seq_cst);
+		if (fd == -1)
+		{
+			std::lock_guard<std::mutex> lock(event->PollMutex);
+			fd = event->PollFd.load(std::memory_order_relaxed);
+			if (fd == -1)
+			{
+				fd = CreatePollFd();
+				if (fd == -1)
+				{
+					return -1;
+				}
+				event->PollFd.store(fd, std::memory_order_seq_cst);
+			}
+		}
+		//Catch up with any transition that happened before the descriptor was visible
+		SyncPollFd(event);
+		return fd;
+	}
+
+	int GetEventWaitStats(neosmart_event_t event, neosmart_event_stats_t &stats)
+	{
+		stats.Spins = event->Spins.load(std::memory_order_relaxed);
+		stats.Yields = event->Yields.load(std::memory_order_relaxed);
+		stats.Blocks = event->Blocks.load(std::memory_order_relaxed);
+		return 0;
+	}
+
+	static int TimedWaitForEvent(neosmart_event_t event, uint64_t nanoseconds)
+	{
+		if (TryAcquire(event))
+		{
+			return 0;
+		}
+
+		//Zero-timeout event state check optimization
+		if (nanoseconds == 0)
+		{
+			return WAIT_TIMEOUT;
+		}
+
+		//A plain load first so that spinning doesn't keep pulling the cache line in exclusive mode
+		if (AdaptiveWait(event->Attributes, nanoseconds, event->Spins, event->Yields,
+			[event]() { return event->State.load(std::memory_order_relaxed) != 0 && TryAcquire(event); }))
+		{
+			return 0;
+		}
+		if (nanoseconds == 0)
+		{
+			return TryAcquire(event) ? 0 : WAIT_TIMEOUT;
+		}
+		event->Blocks.fetch_add(1, std::memory_order_relaxed);
+
+		timespec ts;
+		timespec *deadline = nullptr;
+		if (nanoseconds != InfiniteTimeout)
+		{
+			ts = TimeoutDeadline(CLOCK_MONOTONIC, nanoseconds);
+			deadline = &ts;
+		}
+
+		int result = 0;
+		//The waiter count has to be visible before the state is checked again (and the setter has to
+		//publish the state before reading the count) so that one side always sees the other
+		event->Waiters.fetch_add(1, std::memory_order_seq_cst);
+		while (!TryAcquire(event))
+		{
+			//Returns immediately if the state is no longer 0, EINTR and spurious wakeups just loop around
+			if (FutexWait(&event->State, 0, deadline) != 0 && errno == ETIMEDOUT)
+			{
+				if (!TryAcquire(event))
+				{
+					result = WAIT_TIMEOUT;
+				}
+				break;
+			}
+		}
+		event->Waiters.fetch_sub(1, std::memory_order_seq_cst);
+
+		return result;
+	}
+
+	static int InstrumentedWaitForEvent(neosmart_event_t event, uint64_t nanoseconds)
+	{
+#ifdef PEVENTS_INSTRUMENTATION
+		return InstrumentWait(event->Instrumentation, [=]() { return TimedWaitForEvent(event, nanoseconds); });
+#else
+		return TimedWaitForEvent(event, nanoseconds);
+#endif
+	}
+
+	int WaitForEvent(neosmart_event_t event, uint64_t milliseconds)
+	{
+		return InstrumentedWaitForEvent(event, TimeoutNanoseconds(milliseconds));
+	}
+
+	int WaitForEvent(neosmart_event_t event, std::chrono::nanoseconds timeout)
+	{
+		return InstrumentedWaitForEvent(event, TimeoutNanoseconds(timeout));
+	}
+
+#ifdef PEVENTS_INSTRUMENTATION
+	int GetEventInfo(neosmart_event_t event, neosmart_event_info_t &info)
+	{
+		ReadInstrumentation(event->Instrumentation, info);
+		info.ManualReset = !event->AutoReset;
+		info.Signaled = event->State.load(std::memory_order_relaxed) != 0;
+		return 0;
+	}
+#endif
+
+	int SetEvent(neosmart_event_t event)
+	{
+#ifdef PEVENTS_INSTRUMENTATION
+		event->Instrumentation.Sets.fetch_add(1, std::memory_order_relaxed);
+#endif
+		event->State.store(1, std::memory_order_seq_cst);
+		StateChanged(event);
+		if (event->Waiters.load(std::memory_order_seq_cst) != 0)
+		{
+			//An auto-reset event only releases one waiter, a manual-reset event releases everyone
+			FutexWake(&event->State, event->AutoReset ? 1 : INT_MAX);
+		}
+		return 0;
+	}
+
+	int ResetEvent(neosmart_event_t event)
+	{
+		event->State.store(0, std::memory_order_seq_cst);
+		StateChanged(event);
+		return 0;
+	}
+
+#ifdef PULSE
+	int PulseEvent(neosmart_event_t event)
+	{
+		int result = SetEvent(event);
+		weak_assert(result == 0);
+		result = ResetEvent(event);
+		weak_assert(result == 0);
+
+		return 0;
+	}
+#endif
+} // namespace neosmart
+
+#elif !defined(_WIN32)
+
 #include "types.h"
 #include "pevents.h"
 #include <assert.h>
 #include <errno.h>
-#include <sys/time.h>
 #include <pthread.h>
 #ifdef WFMO
-#include <algorithm>
-#include <deque>
+#include <atomic>
+#include <climits>
+#include <memory>
 #endif
 
 namespace neosmart
 {
+	//Timed waits are measured on the monotonic clock so that stepping the wall clock doesn't stretch or cut
+	//them short, macOS can't select the condition variable clock so it stays on the realtime clock
+#ifdef __APPLE__
+	static const clockid_t ConditionClock = CLOCK_REALTIME;
+#else
+	static const clockid_t ConditionClock = CLOCK_MONOTONIC;
+#endif
+
+	static int InitCondition(pthread_cond_t *condition)
+	{
+		pthread_condattr_t attributes;
+		int result = pthread_condattr_init(&attributes);
+		weak_assert(result == 0);
+#ifndef __APPLE__
+		result = pthread_condattr_setclock(&attributes, ConditionClock);
+		weak_assert(result == 0);
+#endif
+		result = pthread_cond_init(condition, &attributes);
+		pthread_condattr_destroy(&attributes);
+		return result;
+	}
+
 #ifdef WFMO
-	//Each call to WaitForMultipleObjects initializes a neosmart_wfmo_t object which tracks
-	//the progress of the caller's multi-object wait and dispatches responses accordingly.
-	//One neosmart_wfmo_t struct is shared for all events in a single WFMO call
+	struct neosmart_wfmo_info_t_;
+	typedef neosmart_wfmo_info_t_ *neosmart_wfmo_info_t;
+
+	//Each thread that calls WaitForMultipleEvents owns one neosmart_wfmo_t which tracks the progress
+	//of its multi-object wait and is signaled when the wait is satisfied. A thread can only be in one
+	//wait at a time so the record, and the per-event links it hands out, are reused by every call
 	struct neosmart_wfmo_t_
 	{
+		//Status values once the waiter has given up (timed out), events can no longer be handed to it
+		static constexpr int Abandoned = INT_MIN;
+
 		pthread_mutex_t Mutex;
 		pthread_cond_t CVariable;
-		int RefCount;
-		union
-		{
-			int FiredEvent; //WFSO
-			int EventsLeft; //WFMO
-		} Status;
+		//WFSO: the index of the event that fired, -1 while waiting
+		//WFMO: the number of events left to fire
+		std::atomic<int> Status;
 		bool WaitAll;
-		bool StillWaiting;
+		std::unique_ptr<neosmart_wfmo_info_t_[]> Links;
+		int LinkCapacity = 0;
+
+		neosmart_wfmo_t_()
+		{
+			int result = pthread_mutex_init(&Mutex, 0);
+			weak_assert(result == 0);
+			result = InitCondition(&CVariable);
+			weak_assert(result == 0);
+		}
 
-		void Destroy()
+		~neosmart_wfmo_t_()
 		{
 			pthread_mutex_destroy(&Mutex);
 			pthread_cond_destroy(&CVariable);
 		}
+
+		bool Done(int status) const
+		{
+			return WaitAll ? status == 0 : status >= 0;
+		}
+
+		//Try to take an event for this wait, returns false if the wait is already satisfied or abandoned
+		bool Take(int index, bool &complete)
+		{
+			int status = Status.load(std::memory_order_acquire);
+			if (WaitAll)
+			{
+				while (status > 0)
+				{
+					if (Status.compare_exchange_weak(status, status - 1, std::memory_order_acq_rel))
+					{
+						complete = status == 1;
+						return true;
+					}
+				}
+			}
+			else if (status == -1 && Status.compare_exchange_strong(status, index, std::memory_order_acq_rel))
+			{
+				complete = true;
+				return true;
+			}
+			return false;
+		}
 	};
 	typedef neosmart_wfmo_t_ *neosmart_wfmo_t;
 
-	//A neosmart_wfmo_info_t object is registered with each event waited on in a WFMO
+	//A neosmart_wfmo_info_t links a WFMO waiter into the wait list of one of its events
 	//This reference to neosmart_wfmo_t_ is how the event knows whom to notify when triggered
 	struct neosmart_wfmo_info_t_
 	{
 		neosmart_wfmo_t Waiter;
 		int WaitIndex;
+		neosmart_wfmo_info_t Prev;
+		neosmart_wfmo_info_t Next;
+		//Set while the link is on the event's wait list, only cleared (under the event mutex) once the
+		//event is done with the link so the waiter can skip the event mutex when it sees false
+		std::atomic<bool> Linked;
 	};
-	typedef neosmart_wfmo_info_t_ *neosmart_wfmo_info_t;
 #endif // WFMO
 
 	//The basic event structure, passed to the caller as an opaque pointer when creating events
@@ -61,61 +682,121 @@ namespace neosmart
 		pthread_cond_t CVariable;
 		pthread_mutex_t Mutex;
 		bool AutoReset;
-		bool State;
+		//Only written with Mutex held, atomic so the spin in TimedWaitForEvent can peek at it without the mutex
+		std::atomic<bool> State;
+		neosmart_event_attr_t Attributes;
+		std::atomic<uint64_t> Spins{ 0 };
+		std::atomic<uint64_t> Yields{ 0 };
+		std::atomic<uint64_t> Blocks{ 0 };
+#ifdef __linux__
+		//The eventfd from GetEventPollFd, -1 until someone asks for one, both protected by Mutex
+		int PollFd = -1;
+		bool PollSignaled = false;
+#endif
+#ifdef PEVENTS_INSTRUMENTATION
+		neosmart_event_instrumentation_t_ Instrumentation;
+#endif
 #ifdef WFMO
-		std::deque<neosmart_wfmo_info_t_> RegisteredWaits;
+		neosmart_wfmo_info_t WaitHead;
+		neosmart_wfmo_info_t WaitTail;
 #endif
 	};
 
 #ifdef WFMO
-	static bool RemoveExpiredWaitHelper(neosmart_wfmo_info_t_ wait)
+	//The event mutex must be held
+	static void LinkWait(neosmart_event_t event, neosmart_wfmo_info_t info)
 	{
-		int result = pthread_mutex_trylock(&wait.Waiter->Mutex);
+		info->Prev = event->WaitTail;
+		info->Next = nullptr;
+		if (event->WaitTail)
+		{
+			event->WaitTail->Next = info;
+		}
+		else
+		{
+			event->WaitHead = info;
+		}
+		event->WaitTail = info;
+		info->Linked.store(true, std::memory_order_relaxed);
+	}
 
-		if (result == EBUSY)
+	//The event mutex must be held
+	static void UnlinkWait(neosmart_event_t event, neosmart_wfmo_info_t info)
+	{
+		if (info->Prev)
+		{
+			info->Prev->Next = info->Next;
+		}
+		else
+		{
+			event->WaitHead = info->Next;
+		}
+		if (info->Next)
+		{
+			info->Next->Prev = info->Prev;
+		}
+		else
 		{
-			return false;
+			event->WaitTail = info->Prev;
 		}
+		info->Prev = info->Next = nullptr;
+	}
 
+	static void WakeWaiter(neosmart_wfmo_t waiter)
+	{
+		//Passing through the mutex orders the status change before the waiter's predicate check
+		int result = pthread_mutex_lock(&waiter->Mutex);
+		weak_assert(result == 0);
+		result = pthread_mutex_unlock(&waiter->Mutex);
 		weak_assert(result == 0);
 
-		if (wait.Waiter->StillWaiting == false)
-		{
-			--wait.Waiter->RefCount;
-			weak_assert(wait.Waiter->RefCount >= 0);
-			bool destroy = wait.Waiter->RefCount == 0;
-			result = pthread_mutex_unlock(&wait.Waiter->Mutex);
-			weak_assert(result == 0);
-			if (destroy)
-			{
-				wait.Waiter->Destroy();
-				delete wait.Waiter;
-			}
+		result = pthread_cond_signal(&waiter->CVariable);
+		weak_assert(result == 0);
+	}
 
-			return true;
-		}
+	//Take the first registered waiter off the event and try to hand it the event, called with the event mutex
+	//held. Returns false if the waiter has already finished waiting and didn't take the event
+	static bool DispatchWait(neosmart_event_t event)
+	{
+		neosmart_wfmo_info_t info = event->WaitHead;
+		UnlinkWait(event, info);
 
-		result = pthread_mutex_unlock(&wait.Waiter->Mutex);
-		weak_assert(result == 0);
+		neosmart_wfmo_t waiter = info->Waiter;
+		bool complete = false;
+		bool taken = waiter->Take(info->WaitIndex, complete);
+		if (complete)
+		{
+			WakeWaiter(waiter);
+		}
 
-		return false;
+		//The waiter may reuse the link as soon as this is cleared
+		info->Linked.store(false, std::memory_order_release);
+		return taken;
 	}
 #endif
 
-	neosmart_event_t CreateEvent(bool manualReset, bool initialState)
+	neosmart_event_t CreateEvent(const neosmart_event_attr_t &attributes)
 	{
 		neosmart_event_t event = new neosmart_event_t_;
 
-		int result = pthread_cond_init(&event->CVariable, 0);
+		int result = InitCondition(&event->CVariable);
 		weak_assert(result == 0);
 
 		result = pthread_mutex_init(&event->Mutex, 0);
 		weak_assert(result == 0);
 
-		event->State = false;
-		event->AutoReset = !manualReset;
+		event->State.store(false, std::memory_order_relaxed);
+		event->AutoReset = !attributes.ManualReset;
+		event->Attributes = attributes;
+		event->Attributes.Name = nullptr;
+#ifdef WFMO
+		event->WaitHead = event->WaitTail = nullptr;
+#endif
+#ifdef PEVENTS_INSTRUMENTATION
+		RegisterEvent(event->Instrumentation, event, attributes.Name);
+#endif
 
-		if (initialState)
+		if (attributes.InitialState)
 		{
 			result = SetEvent(event);
 			weak_assert(result == 0);
@@ -124,35 +805,44 @@ namespace neosmart
 		return event;
 	}
 
-	static int UnlockedWaitForEvent(neosmart_event_t event, uint64_t milliseconds)
+	//Called with the event mutex held after every change of State
+	static inline void StateChanged(neosmart_event_t event)
+	{
+#ifdef __linux__
+		if (event->PollFd != -1 && event->PollSignaled != event->State.load(std::memory_order_relaxed))
+		{
+			SignalPollFd(event->PollFd, event->State.load(std::memory_order_relaxed));
+			event->PollSignaled = event->State.load(std::memory_order_relaxed);
+		}
+#else
+		(void)event;
+#endif
+	}
+
+	static int UnlockedWaitForEvent(neosmart_event_t event, uint64_t nanoseconds)
 	{
 		int result = 0;
-		if (!event->State)
+		if (!event->State.load(std::memory_order_relaxed))
 		{
 			//Zero-timeout event state check optimization
-			if (milliseconds == 0)
+			if (nanoseconds == 0)
 			{
 				return WAIT_TIMEOUT;
 			}
 
+			event->Blocks.fetch_add(1, std::memory_order_relaxed);
+
 			timespec ts;
-			if (milliseconds != -1ul)
+			if (nanoseconds != InfiniteTimeout)
 			{
-				timeval tv;
-				gettimeofday(&tv, NULL);
-
-                uint64_t nanoseconds = ((uint64_t)tv.tv_sec) * 1000 * 1000 * 1000 +
-                                       milliseconds * 1000 * 1000 + ((uint64_t)tv.tv_usec) * 1000;
-
-				ts.tv_sec = nanoseconds / 1000 / 1000 / 1000;
-                ts.tv_nsec = (long) (nanoseconds - ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000);
+				ts = TimeoutDeadline(ConditionClock, nanoseconds);
 			}
 
 			do
 			{
 				//Regardless of whether it's an auto-reset or manual-reset event:
 				//wait to obtain the event, then lock anyone else out
-				if (milliseconds != -1ul)
+				if (nanoseconds != InfiniteTimeout)
 				{
 					result = pthread_cond_timedwait(&event->CVariable, &event->Mutex, &ts);
 				}
@@ -160,12 +850,13 @@ namespace neosmart
 				{
 					result = pthread_cond_wait(&event->CVariable, &event->Mutex);
 				}
-			} while (result == 0 && !event->State);
+			} while (result == 0 && !event->State.load(std::memory_order_relaxed));
 
 			if (result == 0 && event->AutoReset)
 			{
 				//We've only accquired the event if the wait succeeded
-				event->State = false;
+				event->State.store(false, std::memory_order_release);
+				StateChanged(event);
 			}
 		}
 		else if (event->AutoReset)
@@ -173,7 +864,8 @@ namespace neosmart
 			//It's an auto-reset event that's currently available;
 			//we need to stop anyone else from using it
 			result = 0;
-			event->State = false;
+			event->State.store(false, std::memory_order_release);
+			StateChanged(event);
 		}
 		//Else we're trying to obtain a manual reset event with a signaled state;
 		//don't do anything
@@ -181,10 +873,10 @@ namespace neosmart
 		return result;
 	}
 
-	int WaitForEvent(neosmart_event_t event, uint64_t milliseconds)
+	static int TimedWaitForEvent(neosmart_event_t event, uint64_t nanoseconds)
 	{
 		int tempResult;
-		if (milliseconds == 0)
+		if (nanoseconds == 0)
 		{
 			tempResult = pthread_mutex_trylock(&event->Mutex);
 			if (tempResult == EBUSY)
@@ -199,7 +891,37 @@ namespace neosmart
 
 		weak_assert(tempResult == 0);
 
-		int result = UnlockedWaitForEvent(event, milliseconds);
+		int result;
+		if (nanoseconds != 0 && (event->Attributes.SpinCount != 0 || event->Attributes.YieldCount != 0))
+		{
+			result = UnlockedWaitForEvent(event, 0);
+			tempResult = pthread_mutex_unlock(&event->Mutex);
+			weak_assert(tempResult == 0);
+			if (result == 0)
+			{
+				return 0;
+			}
+
+			//Peek at the state without the mutex while spinning, only taking it once the event looks signaled
+			if (AdaptiveWait(event->Attributes, nanoseconds, event->Spins, event->Yields, [event]()
+				{
+					if (!event->State.load(std::memory_order_relaxed) || pthread_mutex_trylock(&event->Mutex) != 0)
+					{
+						return false;
+					}
+					bool acquired = UnlockedWaitForEvent(event, 0) == 0;
+					pthread_mutex_unlock(&event->Mutex);
+					return acquired;
+				}))
+			{
+				return 0;
+			}
+
+			tempResult = pthread_mutex_lock(&event->Mutex);
+			weak_assert(tempResult == 0);
+		}
+
+		result = UnlockedWaitForEvent(event, nanoseconds);
 
 		tempResult = pthread_mutex_unlock(&event->Mutex);
 		weak_assert(tempResult == 0);
@@ -207,178 +929,230 @@ namespace neosmart
 		return result;
 	}
 
-#ifdef WFMO
-	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, uint64_t milliseconds)
+	static int InstrumentedWaitForEvent(neosmart_event_t event, uint64_t nanoseconds)
 	{
-		int unused;
-		return WaitForMultipleEvents(events, count, waitAll, milliseconds, unused);
+#ifdef PEVENTS_INSTRUMENTATION
+		return InstrumentWait(event->Instrumentation, [=]() { return TimedWaitForEvent(event, nanoseconds); });
+#else
+		return TimedWaitForEvent(event, nanoseconds);
+#endif
 	}
 
-	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, uint64_t milliseconds, int &waitIndex)
+	int WaitForEvent(neosmart_event_t event, uint64_t milliseconds)
 	{
-		neosmart_wfmo_t wfmo = new neosmart_wfmo_t_;
-
-		int result = 0;
-		int tempResult = pthread_mutex_init(&wfmo->Mutex, 0);
-		weak_assert(tempResult == 0);
+		return InstrumentedWaitForEvent(event, TimeoutNanoseconds(milliseconds));
+	}
 
-		tempResult = pthread_cond_init(&wfmo->CVariable, 0);
-		weak_assert(tempResult == 0);
+	int WaitForEvent(neosmart_event_t event, std::chrono::nanoseconds timeout)
+	{
+		return InstrumentedWaitForEvent(event, TimeoutNanoseconds(timeout));
+	}
 
-		neosmart_wfmo_info_t_ waitInfo;
-		waitInfo.Waiter = wfmo;
-		waitInfo.WaitIndex = -1;
+#ifdef PEVENTS_INSTRUMENTATION
+	int GetEventInfo(neosmart_event_t event, neosmart_event_info_t &info)
+	{
+		ReadInstrumentation(event->Instrumentation, info);
+		info.ManualReset = !event->AutoReset;
+		//Only a snapshot for reporting, not worth taking the event mutex for
+		info.Signaled = event->State.load(std::memory_order_relaxed);
+		return 0;
+	}
+#endif
 
-		wfmo->WaitAll = waitAll;
-		wfmo->StillWaiting = true;
-		wfmo->RefCount = 1;
+#ifdef WFMO
+	static int TimedWaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, uint64_t nanoseconds, int &waitIndex)
+	{
+		static thread_local neosmart_wfmo_t_ threadWaiter;
+		neosmart_wfmo_t wfmo = &threadWaiter;
 
-		if (waitAll)
+		//Only grows, so a dispatcher waiting on the same events in a loop doesn't allocate
+		if (wfmo->LinkCapacity < count)
 		{
-			wfmo->Status.EventsLeft = count;
-		}
-		else
-		{
-			wfmo->Status.FiredEvent = -1;
+			wfmo->Links.reset(new neosmart_wfmo_info_t_[count]);
+			wfmo->LinkCapacity = count;
 		}
 
-		tempResult = pthread_mutex_lock(&wfmo->Mutex);
-		weak_assert(tempResult == 0);
+		int result = 0;
+		int tempResult;
 
-		bool done = false;
-		waitIndex = -1;
+		wfmo->WaitAll = waitAll;
+		wfmo->Status.store(waitAll ? count : -1, std::memory_order_relaxed);
 
-		for (int i = 0; i < count; ++i)
+		int registered = 0;
+		for (int i = 0; i < count && !wfmo->Done(wfmo->Status.load(std::memory_order_acquire)); ++i)
 		{
-			waitInfo.WaitIndex = i;
+			neosmart_wfmo_info_t info = &wfmo->Links[i];
+			info->Waiter = wfmo;
+			info->WaitIndex = i;
+			info->Linked.store(false, std::memory_order_relaxed);
 
-			//Must not release lock until RegisteredWait is potentially added
 			tempResult = pthread_mutex_lock(&events[i]->Mutex);
 			weak_assert(tempResult == 0);
 
-            // Before adding this wait to the list of registered waits, let's clean up old, expired
-            // waits while we have the event lock anyway
-            events[i]->RegisteredWaits.erase(std::remove_if(events[i]->RegisteredWaits.begin(),
-                                                            events[i]->RegisteredWaits.end(),
-                                                            RemoveExpiredWaitHelper),
-                                             events[i]->RegisteredWaits.end());
-
-			if (UnlockedWaitForEvent(events[i], 0) == 0)
+			if (!events[i]->State.load(std::memory_order_relaxed))
 			{
-				tempResult = pthread_mutex_unlock(&events[i]->Mutex);
-				weak_assert(tempResult == 0);
-
-				if (waitAll)
-				{
-					--wfmo->Status.EventsLeft;
-					weak_assert(wfmo->Status.EventsLeft >= 0);
-				}
-				else
-				{
-					wfmo->Status.FiredEvent = i;
-					waitIndex = i;
-					done = true;
-					break;
-				}
+				LinkWait(events[i], info);
 			}
 			else
 			{
-				events[i]->RegisteredWaits.push_back(waitInfo);
-				++wfmo->RefCount;
-
-				tempResult = pthread_mutex_unlock(&events[i]->Mutex);
-				weak_assert(tempResult == 0);
-			}
-		}
-
-        // We set the `done` flag above in case of WaitAny and at least one event was set.
-        // But we need to check again here if we were doing a WaitAll or else we'll incorrectly
-        // return WAIT_TIMEOUT.
-        if (waitAll && wfmo->Status.EventsLeft == 0)
-        {
-            done = true;
-        }
-
-		timespec ts;
-		if (!done)
-		{
-			if (milliseconds == 0)
-			{
-				result = WAIT_TIMEOUT;
-				done = true;
+				//Only consume the event if one of the events we've already registered with hasn't satisfied the wait
+				bool complete;
+				if (wfmo->Take(i, complete))
+				{
+					tempResult = UnlockedWaitForEvent(events[i], 0);
+					weak_assert(tempResult == 0);
+				}
 			}
-			else if (milliseconds != -1ul)
-			{
-				timeval tv;
-				gettimeofday(&tv, NULL);
 
-                uint64_t nanoseconds = ((uint64_t)tv.tv_sec) * 1000 * 1000 * 1000 +
-                                       milliseconds * 1000 * 1000 + ((uint64_t)tv.tv_usec) * 1000;
+			tempResult = pthread_mutex_unlock(&events[i]->Mutex);
+			weak_assert(tempResult == 0);
 
-				ts.tv_sec = nanoseconds / 1000 / 1000 / 1000;
-                ts.tv_nsec = (long) (nanoseconds - ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000);
-			}
+			registered = i + 1;
 		}
 
-		while (!done)
+		int status = wfmo->Status.load(std::memory_order_acquire);
+		if (!wfmo->Done(status))
 		{
-			//One (or more) of the events we're monitoring has been triggered?
-
-            // If we're waiting for all events, assume we're done and check if there's an event that
-            // hasn't fired But if we're waiting for just one event, assume we're not done until we
-            // find a fired event
-            done = (waitAll && wfmo->Status.EventsLeft == 0) ||
-                   (!waitAll && wfmo->Status.FiredEvent != -1);
-
-			if (!done)
+			if (nanoseconds != 0)
 			{
-				if (milliseconds != -1ul)
+				timespec ts;
+				if (nanoseconds != InfiniteTimeout)
 				{
-					result = pthread_cond_timedwait(&wfmo->CVariable, &wfmo->Mutex, &ts);
+					ts = TimeoutDeadline(ConditionClock, nanoseconds);
 				}
-				else
+
+				tempResult = pthread_mutex_lock(&wfmo->Mutex);
+				weak_assert(tempResult == 0);
+
+				while (!wfmo->Done(status = wfmo->Status.load(std::memory_order_acquire)))
 				{
-					result = pthread_cond_wait(&wfmo->CVariable, &wfmo->Mutex);
+					if (nanoseconds != InfiniteTimeout)
+					{
+						tempResult = pthread_cond_timedwait(&wfmo->CVariable, &wfmo->Mutex, &ts);
+					}
+					else
+					{
+						tempResult = pthread_cond_wait(&wfmo->CVariable, &wfmo->Mutex);
+					}
+
+					if (tempResult != 0)
+					{
+						break;
+					}
 				}
 
-				if (result != 0)
+				tempResult = pthread_mutex_unlock(&wfmo->Mutex);
+				weak_assert(tempResult == 0);
+			}
+
+			//Stop any event from being handed to us, unless the wait was satisfied just as it timed out
+			while (!wfmo->Done(status))
+			{
+				if (wfmo->Status.compare_exchange_weak(status, neosmart_wfmo_t_::Abandoned, std::memory_order_acq_rel))
 				{
+					result = WAIT_TIMEOUT;
 					break;
 				}
 			}
 		}
 
-		waitIndex = wfmo->Status.FiredEvent;
-		wfmo->StillWaiting = false;
+		waitIndex = (result == 0 && !waitAll) ? status : -1;
 
-		--wfmo->RefCount;
-		weak_assert(wfmo->RefCount >= 0);
-		bool destroy = wfmo->RefCount == 0;
-		tempResult = pthread_mutex_unlock(&wfmo->Mutex);
-		weak_assert(tempResult == 0);
-		if (destroy)
+		//Take ourselves off the wait lists that haven't already dropped us
+		for (int i = 0; i < registered; ++i)
 		{
-			wfmo->Destroy();
-			delete wfmo;
+			neosmart_wfmo_info_t info = &wfmo->Links[i];
+			if (info->Linked.load(std::memory_order_acquire))
+			{
+				tempResult = pthread_mutex_lock(&events[i]->Mutex);
+				weak_assert(tempResult == 0);
+
+				if (info->Linked.load(std::memory_order_relaxed))
+				{
+					UnlinkWait(events[i], info);
+					info->Linked.store(false, std::memory_order_relaxed);
+				}
+
+				tempResult = pthread_mutex_unlock(&events[i]->Mutex);
+				weak_assert(tempResult == 0);
+			}
 		}
 
 		return result;
 	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, uint64_t milliseconds)
+	{
+		int unused;
+		return TimedWaitForMultipleEvents(events, count, waitAll, TimeoutNanoseconds(milliseconds), unused);
+	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, uint64_t milliseconds, int &waitIndex)
+	{
+		return TimedWaitForMultipleEvents(events, count, waitAll, TimeoutNanoseconds(milliseconds), waitIndex);
+	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, std::chrono::nanoseconds timeout)
+	{
+		int unused;
+		return TimedWaitForMultipleEvents(events, count, waitAll, TimeoutNanoseconds(timeout), unused);
+	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, std::chrono::nanoseconds timeout, int &waitIndex)
+	{
+		return TimedWaitForMultipleEvents(events, count, waitAll, TimeoutNanoseconds(timeout), waitIndex);
+	}
 #endif // WFMO
 
-	int DestroyEvent(neosmart_event_t event)
+	int GetEventWaitStats(neosmart_event_t event, neosmart_event_stats_t &stats)
 	{
-		int result = 0;
+		stats.Spins = event->Spins.load(std::memory_order_relaxed);
+		stats.Yields = event->Yields.load(std::memory_order_relaxed);
+		stats.Blocks = event->Blocks.load(std::memory_order_relaxed);
+		return 0;
+	}
 
-#ifdef WFMO
-		result = pthread_mutex_lock(&event->Mutex);
+#ifdef __linux__
+	int GetEventPollFd(neosmart_event_t event)
+	{
+		int result = pthread_mutex_lock(&event->Mutex);
 		weak_assert(result == 0);
-        event->RegisteredWaits.erase(std::remove_if(event->RegisteredWaits.begin(),
-                                                    event->RegisteredWaits.end(),
-                                                    RemoveExpiredWaitHelper),
-                                     event->RegisteredWaits.end());
+
+		if (event->PollFd == -1)
+		{
+			event->PollFd = CreatePollFd();
+		}
+		int fd = event->PollFd;
+		if (fd != -1)
+		{
+			StateChanged(event);
+		}
+
 		result = pthread_mutex_unlock(&event->Mutex);
 		weak_assert(result == 0);
+
+		return fd;
+	}
+#endif
+
+	int DestroyEvent(neosmart_event_t event)
+	{
+		int result = 0;
+
+#ifdef PEVENTS_INSTRUMENTATION
+		UnregisterEvent(event->Instrumentation);
+#endif
+
+#ifdef WFMO
+		//Waiters take themselves off the list before WaitForMultipleEvents returns
+		weak_assert(event->WaitHead == nullptr);
+#endif
+
+#ifdef __linux__
+		if (event->PollFd != -1)
+		{
+			close(event->PollFd);
+		}
 #endif
 
 		result = pthread_cond_destroy(&event->CVariable);
@@ -394,72 +1168,37 @@ namespace neosmart
 
 	int SetEvent(neosmart_event_t event)
 	{
+#ifdef PEVENTS_INSTRUMENTATION
+		event->Instrumentation.Sets.fetch_add(1, std::memory_order_relaxed);
+#endif
 		int result = pthread_mutex_lock(&event->Mutex);
 		weak_assert(result == 0);
 
-		event->State = true;
+		event->State.store(true, std::memory_order_release);
 
 		//Depending on the event type, we either trigger everyone or only one
 		if (event->AutoReset)
 		{
 #ifdef WFMO
-			while (!event->RegisteredWaits.empty())
+			//Registered waiters are served first, in the order they started waiting
+			while (event->WaitHead)
 			{
-				neosmart_wfmo_info_t i = &event->RegisteredWaits.front();
-
-				result = pthread_mutex_lock(&i->Waiter->Mutex);
-				weak_assert(result == 0);
-
-				--i->Waiter->RefCount;
-				weak_assert(i->Waiter->RefCount >= 0);
-				if (!i->Waiter->StillWaiting)
+				if (DispatchWait(event))
 				{
-					bool destroy = i->Waiter->RefCount == 0;
-					result = pthread_mutex_unlock(&i->Waiter->Mutex);
-					weak_assert(result == 0);
-					if (destroy)
-					{
-						i->Waiter->Destroy();
-						delete i->Waiter;
-					}
-					event->RegisteredWaits.pop_front();
-					continue;
-				}
+					event->State.store(false, std::memory_order_release);
+					StateChanged(event);
 
-				event->State = false;
+					result = pthread_mutex_unlock(&event->Mutex);
+					weak_assert(result == 0);
 
-				if (i->Waiter->WaitAll)
-				{
-					--i->Waiter->Status.EventsLeft;
-					weak_assert(i->Waiter->Status.EventsLeft >= 0);
-                    // We technically should do i->Waiter->StillWaiting = Waiter->Status.EventsLeft
-                    // != 0 but the only time it'll be equal to zero is if we're the last event, so
-                    // no one else will be checking the StillWaiting flag. We're good to go without
-                    // it.
-				}
-				else
-				{
-					i->Waiter->Status.FiredEvent = i->WaitIndex;
-					i->Waiter->StillWaiting = false;
+					return 0;
 				}
-
-				result = pthread_mutex_unlock(&i->Waiter->Mutex);
-				weak_assert(result == 0);
-
-				result = pthread_cond_signal(&i->Waiter->CVariable);
-				weak_assert(result == 0);
-
-				event->RegisteredWaits.pop_front();
-
-				result = pthread_mutex_unlock(&event->Mutex);
-				weak_assert(result == 0);
-
-				return 0;
 			}
 #endif // WFMO
-			//event->State can be false if compiled with WFMO support
-			if (event->State)
+			//event->State.load(std::memory_order_relaxed) can be false if compiled with WFMO support
+			if (event->State.load(std::memory_order_relaxed))
 			{
+				StateChanged(event);
 				result = pthread_mutex_unlock(&event->Mutex);
 				weak_assert(result == 0);
 
@@ -472,52 +1211,12 @@ namespace neosmart
 		else
 		{
 #ifdef WFMO
-			for (size_t i = 0; i < event->RegisteredWaits.size(); ++i)
+			while (event->WaitHead)
 			{
-				neosmart_wfmo_info_t info = &event->RegisteredWaits[i];
-
-				result = pthread_mutex_lock(&info->Waiter->Mutex);
-				weak_assert(result == 0);
-
-				--info->Waiter->RefCount;
-				weak_assert(info->Waiter->RefCount >= 0);
-
-				if (!info->Waiter->StillWaiting)
-				{
-					bool destroy = info->Waiter->RefCount == 0;
-					result = pthread_mutex_unlock(&info->Waiter->Mutex);
-					weak_assert(result == 0);
-					if (destroy)
-					{
-						info->Waiter->Destroy();
-						delete info->Waiter;
-					}
-					continue;
-				}
-
-				if (info->Waiter->WaitAll)
-				{
-					--info->Waiter->Status.EventsLeft;
-					weak_assert(info->Waiter->Status.EventsLeft >= 0);
-                    // We technically should do i->Waiter->StillWaiting = Waiter->Status.EventsLeft
-                    // != 0 but the only time it'll be equal to zero is if we're the last event, so
-                    // no one else will be checking the StillWaiting flag. We're good to go without
-                    // it.
-				}
-				else
-				{
-					info->Waiter->Status.FiredEvent = info->WaitIndex;
-					info->Waiter->StillWaiting = false;
-				}
-
-				result = pthread_mutex_unlock(&info->Waiter->Mutex);
-				weak_assert(result == 0);
-
-				result = pthread_cond_signal(&info->Waiter->CVariable);
-				weak_assert(result == 0);
+				DispatchWait(event);
 			}
-			event->RegisteredWaits.clear();
 #endif // WFMO
+			StateChanged(event);
 			result = pthread_mutex_unlock(&event->Mutex);
 			weak_assert(result == 0);
 
@@ -533,7 +1232,8 @@ namespace neosmart
 		int result = pthread_mutex_lock(&event->Mutex);
 		weak_assert(result == 0);
 
-		event->State = false;
+		event->State.store(false, std::memory_order_release);
+		StateChanged(event);
 
 		result = pthread_mutex_unlock(&event->Mutex);
 		weak_assert(result == 0);
@@ -571,11 +1271,45 @@ namespace neosmart
 
 namespace neosmart
 {
+	//Windows waits have millisecond resolution, round up so short timeouts don't become polls
+	static uint64_t TimeoutMilliseconds(std::chrono::nanoseconds timeout)
+	{
+		if (timeout == std::chrono::nanoseconds::max())
+		{
+			return -1ul;
+		}
+		if (timeout.count() <= 0)
+		{
+			return 0;
+		}
+		return (uint64_t)std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+	}
+
 	neosmart_event_t CreateEvent(bool manualReset, bool initialState)
 	{
 		return static_cast<neosmart_event_t>(::CreateEvent(NULL, manualReset, initialState, NULL));
 	}
 
+	//The name is only used for instrumentation, a named Win32 event would be shared between processes
+	neosmart_event_t CreateEvent(bool manualReset, bool initialState, const char *name)
+	{
+		(void)name;
+		return CreateEvent(manualReset, initialState);
+	}
+
+	//Windows already spins briefly in the kernel wait path, the spin and yield budgets are ignored
+	neosmart_event_t CreateEvent(const neosmart_event_attr_t &attributes)
+	{
+		return CreateEvent(attributes.ManualReset, attributes.InitialState);
+	}
+
+	int GetEventWaitStats(neosmart_event_t event, neosmart_event_stats_t &stats)
+	{
+		(void)event;
+		stats = neosmart_event_stats_t();
+		return 0;
+	}
+
 	int DestroyEvent(neosmart_event_t event)
 	{
 		HANDLE handle = static_cast<HANDLE>(event);
@@ -624,6 +1358,11 @@ namespace neosmart
 		return GetLastError();
 	}
 
+	int WaitForEvent(neosmart_event_t event, std::chrono::nanoseconds timeout)
+	{
+		return WaitForEvent(event, TimeoutMilliseconds(timeout));
+	}
+
 	int SetEvent(neosmart_event_t event)
 	{
 		HANDLE handle = static_cast<HANDLE>(event);
@@ -684,6 +1423,17 @@ namespace neosmart
 		}
 		return result;
 	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, std::chrono::nanoseconds timeout)
+	{
+		int index = 0;
+		return WaitForMultipleEvents(events, count, waitAll, TimeoutMilliseconds(timeout), index);
+	}
+
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll, std::chrono::nanoseconds timeout, int &index)
+	{
+		return WaitForMultipleEvents(events, count, waitAll, TimeoutMilliseconds(timeout), index);
+	}
 #endif
 
 #ifdef PULSE
@@ -696,3 +1446,39 @@ namespace neosmart
 } // namespace neosmart
 
 #endif //_WIN32
+
+#if !defined(_WIN32) && defined(PEVENTS_INSTRUMENTATION)
+namespace neosmart
+{
+	void DumpEvents(FILE *out)
+	{
+		std::lock_guard<std::mutex> lock(RegistryMutex());
+		size_t count = 0;
+		for (neosmart_event_instrumentation_t_ *i = RegistryHead(); i; i = i->Next)
+		{
+			neosmart_event_info_t info;
+			GetEventInfo(i->Event, info);
+			fprintf(out, "%s (%p) %s-reset %s: sets %" PRIu64 ", waits %" PRIu64 ", timeouts %" PRIu64
+				", waiters %" PRIu32 " (peak %" PRIu32 "), wait mean %.1f us max %.1f us\n",
+				info.Name.size() ? info.Name.c_str() : "<unnamed>", (void *)i->Event, info.ManualReset ? "manual" : "auto",
+				info.Signaled ? "signaled" : "unsignaled", info.Sets, info.Waits, info.Timeouts, info.Waiters,
+				info.PeakWaiters, info.Waits ? info.TotalWaitNanoseconds / 1000.0 / info.Waits : 0.0,
+				info.MaxWaitNanoseconds / 1000.0);
+			if (info.Waits)
+			{
+				fprintf(out, "    wait us:");
+				for (int bucket = 0; bucket < EventWaitHistogramBuckets; ++bucket)
+				{
+					if (info.WaitHistogram[bucket])
+					{
+						fprintf(out, " <%" PRIu64 ":%" PRIu64, ((uint64_t)1) << bucket, info.WaitHistogram[bucket]);
+					}
+				}
+				fprintf(out, "\n");
+			}
+			++count;
+		}
+		fprintf(out, "%zu live events\n", count);
+	}
+} // namespace neosmart
+#endif
@@ -205,484 +205,55 @@ HRESULT VariantToDouble_(const VARIANT &varIn, DOUBLE *pdblRet) {
 #endif
 
 bool variantToBoolean(const NumericVariant &varIn, bool *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::get<std::int32_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::get<std::int64_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::get<std::uint32_t>(varIn)) ? true : false;
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::get<std::uint64_t>(varIn)) ? true : false;
-
-	else {
-		weak_assert(false);
-		*retval = false;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToInt8(const NumericVariant &varIn, std::int8_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::int8_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::int8_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::int8_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToInt16(const NumericVariant &varIn, std::int16_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::int16_t)(std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::int16_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::int16_t)(std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::int16_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::int16_t)(std::int16_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::int16_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToInt32(const NumericVariant &varIn, std::int32_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::int32_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::int32_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::int32_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::int32_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToInt64(const NumericVariant &varIn, std::int64_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::int64_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::int64_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToUInt8(const NumericVariant &varIn, std::uint8_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::uint8_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::uint8_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::uint8_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToUInt16(const NumericVariant &varIn, std::uint16_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::uint16_t)(std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::uint16_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::uint16_t)(std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::uint16_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::uint16_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::uint16_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToUInt32(const NumericVariant &varIn, std::uint32_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::uint32_t)(std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::uint32_t)(std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::uint32_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::uint32_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToUInt64(const NumericVariant &varIn, std::uint64_t *retval) {
-
-	if (std::holds_alternative<bool>(varIn))
-		*retval = (std::get<bool>(varIn)) ? 1 : 0;
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*retval = (std::get<std::int8_t>(varIn));
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*retval = (std::get<std::int16_t>(varIn));
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*retval = (std::get<std::int32_t>(varIn));
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*retval = (std::get<std::int64_t>(varIn));
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*retval = (std::get<std::uint8_t>(varIn));
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*retval = (std::get<std::uint16_t>(varIn));
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*retval = (std::get<std::uint32_t>(varIn));
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*retval = (std::get<std::uint64_t>(varIn));
-
-	else if (std::holds_alternative<float>(varIn))
-		*retval = (std::uint64_t)(std::get<float>(varIn) + 0.5);
-
-	else if (std::holds_alternative<double>(varIn))
-		*retval = (std::uint64_t)(std::get<double>(varIn) + 0.5);
-
-	else {
-		weak_assert(false);
-		*retval = 0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, retval);
 }
 
 
 bool variantToFloat(const NumericVariant &varIn, float *pdblRet) {
-
-	if (std::holds_alternative<double>(varIn))
-		*pdblRet = (float)std::get<double>(varIn);
-
-	else if (std::holds_alternative<float>(varIn))
-		*pdblRet = std::get<float>(varIn);
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*pdblRet = (float)std::get<std::int8_t>(varIn);
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*pdblRet = (float)std::get<std::int16_t>(varIn);
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*pdblRet = (float)std::get<std::int32_t>(varIn);
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*pdblRet = (float)std::get<std::int64_t>(varIn);
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*pdblRet = (float)std::get<std::uint8_t>(varIn);
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*pdblRet = (float)std::get<std::uint16_t>(varIn);
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*pdblRet = (float)std::get<std::uint32_t>(varIn);
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*pdblRet = (float)std::get<std::uint64_t>(varIn);
-
-	else {
-		weak_assert(false);
-		*pdblRet = 0.0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, pdblRet);
 }
 
 
 bool variantToDouble(const NumericVariant &varIn, double *pdblRet) {
-
-	if (std::holds_alternative<double>(varIn))
-		*pdblRet = std::get<double>(varIn);
-
-	else if (std::holds_alternative<float>(varIn))
-		*pdblRet = std::get<float>(varIn);
-
-	else if (std::holds_alternative<std::int8_t>(varIn))
-		*pdblRet = (double)std::get<std::int8_t>(varIn);
-
-	else if (std::holds_alternative<std::int16_t>(varIn))
-		*pdblRet = (double)std::get<std::int16_t>(varIn);
-
-	else if (std::holds_alternative<std::int32_t>(varIn))
-		*pdblRet = (double)std::get<std::int32_t>(varIn);
-
-	else if (std::holds_alternative<std::int64_t>(varIn))
-		*pdblRet = (double)std::get<std::int64_t>(varIn);
-
-	else if (std::holds_alternative<std::uint8_t>(varIn))
-		*pdblRet = (double)std::get<std::uint8_t>(varIn);
-
-	else if (std::holds_alternative<std::uint16_t>(varIn))
-		*pdblRet = (double)std::get<std::uint16_t>(varIn);
-
-	else if (std::holds_alternative<std::uint32_t>(varIn))
-		*pdblRet = (double)std::get<std::uint32_t>(varIn);
-
-	else if (std::holds_alternative<std::uint64_t>(varIn))
-		*pdblRet = (double)std::get<std::uint64_t>(varIn);
-
-	else {
-		weak_assert(false);
-		*pdblRet = 0.0;
-		return false;
-	}
-
-	return true;
+	return variantTo(varIn, pdblRet);
 }
-
@@ -0,0 +1,354 @@
+/**
+ * thread_pool.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intel_check.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace
+{
+	thread_local const hss::thread_pool* t_pool = nullptr;
+	thread_local int t_worker = -1;
+
+#ifdef __linux__
+	/// <summary>
+	/// Parse a kernel cpu list, ex. "0-3,8,10-11".
+	/// </summary>
+	std::vector<int> parseCpuList(const char* list)
+	{
+		std::vector<int> cpus;
+		while (*list)
+		{
+			char* end;
+			long first = std::strtol(list, &end, 10);
+			if (end == list)
+				break;
+			long last = first;
+			if (*end == '-')
+				last = std::strtol(end + 1, &end, 10);
+			for (long cpu = first; cpu <= last; cpu++)
+				cpus.push_back((int)cpu);
+			list = end;
+			if (*list == ',')
+				list++;
+			else
+				break;
+		}
+		return cpus;
+	}
+
+	/// <summary>
+	/// The processors of each NUMA node, only including those the process may run on. Empty nodes are dropped.
+	/// </summary>
+	std::vector<std::vector<int>> numaNodes(const cpu_set_t& allowed)
+	{
+		std::vector<std::pair<int, std::vector<int>>> nodes;
+		DIR* dir = opendir("/sys/devices/system/node");
+		if (!dir)
+			return {};
+		while (dirent* entry = readdir(dir))
+		{
+			int node;
+			if (std::sscanf(entry->d_name, "node%d", &node) != 1)
+				continue;
+			char path[128];
+			std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+			FILE* file = std::fopen(path, "r");
+			if (!file)
+				continue;
+			char line[4096];
+			std::vector<int> cpus;
+			if (std::fgets(line, sizeof(line), file))
+				cpus = parseCpuList(line);
+			std::fclose(file);
+			cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&allowed](int cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); }), cpus.end());
+			if (cpus.size())
+				nodes.emplace_back(node, std::move(cpus));
+		}
+		closedir(dir);
+
+		std::sort(nodes.begin(), nodes.end());
+		std::vector<std::vector<int>> retval;
+		for (auto& node : nodes)
+			retval.push_back(std::move(node.second));
+		return retval;
+	}
+#endif
+}
+
+
+size_t hss::thread_pool::priority_index(int priority) noexcept
+{
+	switch (priority)
+	{
+	case THREAD_PRIORITY_LOWEST:
+		return 0;
+	case THREAD_PRIORITY_BELOW_NORMAL:
+		return 1;
+	case THREAD_PRIORITY_ABOVE_NORMAL:
+		return 3;
+	case THREAD_PRIORITY_HIGHEST:
+		return 4;
+	default:
+		return 2;
+	}
+}
+
+
+hss::thread_pool::thread_pool(const thread_pool_options& options)
+{
+	//the processors available to the pool, grouped by NUMA node
+	std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	{
+		if (options.numa_aware)
+			nodes = numaNodes(allowed);
+		if (nodes.size() < 2)
+		{
+			nodes.clear();
+			nodes.emplace_back();
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &allowed))
+					nodes.back().push_back(cpu);
+			}
+		}
+	}
+#endif
+	if (nodes.empty() || nodes.front().empty())
+	{
+		nodes.assign(1, std::vector<int>());
+		unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned int cpu = 0; cpu < count; cpu++)
+			nodes.front().push_back((int)cpu);
+	}
+	m_nodeCount = nodes.size();
+
+	size_t processors = 0;
+	for (auto& node : nodes)
+		processors += node.size();
+	size_t count = options.thread_count ? options.thread_count : processors;
+
+	//deal the workers out over the nodes, and over the processors within each node
+	m_workers.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto w = std::make_unique<worker>();
+		w->wake = neosmart::CreateEvent(false, false);
+		w->node = i % m_nodeCount;
+		auto& cpus = nodes[w->node];
+		if (options.pin_threads)
+			w->affinity.push_back(cpus[(i / m_nodeCount) % cpus.size()]);
+		else if (m_nodeCount > 1)
+			w->affinity = cpus;
+		m_workers.push_back(std::move(w));
+	}
+
+	//steal from the rest of the node first, then the other nodes, starting next to ourselves so that the
+	//workers don't all converge on the same victim
+	m_stealOrder.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (size_t j = 1; j < count; j++)
+			{
+				size_t victim = (i + j) % count;
+				if ((m_workers[victim]->node == m_workers[i]->node) == (pass == 0))
+					m_stealOrder[i].push_back(victim);
+			}
+		}
+	}
+
+	m_idle.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		m_workers[i]->thread = std::thread(&thread_pool::run, this, i);
+}
+
+
+hss::thread_pool::~thread_pool()
+{
+	m_stopping.store(true);
+	for (auto& w : m_workers)
+		neosmart::SetEvent(w->wake);
+	for (auto& w : m_workers)
+	{
+		w->thread.join();
+		neosmart::DestroyEvent(w->wake);
+	}
+}
+
+
+int hss::thread_pool::current_worker() const noexcept
+{
+	return t_pool == this ? t_worker : -1;
+}
+
+
+void hss::thread_pool::enqueue(task_ptr&& task, int priority)
+{
+	size_t queue = priority_index(priority);
+	int self = current_worker();
+	size_t target = self >= 0 ? (size_t)self : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+	{
+		std::lock_guard<std::mutex> lock(m_workers[target]->lock);
+		m_workers[target]->queues[queue].push_back(std::move(task));
+	}
+
+	//pairs with the idle worker registering itself before it checks m_queued, one of them always sees the other
+	m_queued.fetch_add(1, std::memory_order_seq_cst);
+	if (m_idleCount.load(std::memory_order_seq_cst))
+		wake_idle(target);
+}
+
+
+void hss::thread_pool::wake_idle(size_t preferred)
+{
+	size_t index;
+	{
+		std::lock_guard<std::mutex> lock(m_idleLock);
+		if (m_idle.empty())
+			return;
+		auto it = std::find(m_idle.begin(), m_idle.end(), preferred);
+		if (it == m_idle.end())
+			it = m_idle.end() - 1;
+		index = *it;
+		m_idle.erase(it);
+		m_idleCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+	neosmart::SetEvent(m_workers[index]->wake);
+}
+
+
+hss::thread_pool::task_ptr hss::thread_pool::pop(size_t index)
+{
+	worker& w = *m_workers[index];
+	std::lock_guard<std::mutex> lock(w.lock);
+	for (size_t queue = priority_count; queue-- > 0; )
+	{
+		if (!w.queues[queue].empty())
+		{
+			task_ptr task = std::move(w.queues[queue].back());
+			w.queues[queue].pop_back();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+
+hss::thread_pool::task_ptr hss::thread_pool::steal(size_t index)
+{
+	for (size_t victim : m_stealOrder[index])
+	{
+		worker& w = *m_workers[victim];
+		std::lock_guard<std::mutex> lock(w.lock);
+		for (size_t queue = priority_count; queue-- > 0; )
+		{
+			if (!w.queues[queue].empty())
+			{
+				task_ptr task = std::move(w.queues[queue].front());
+				w.queues[queue].pop_front();
+				m_queued.fetch_sub(1, std::memory_order_relaxed);
+				return task;
+			}
+		}
+	}
+	return nullptr;
+}
+
+
+void hss::thread_pool::run(size_t index)
+{
+	t_pool = this;
+	t_worker = (int)index;
+
+	worker& w = *m_workers[index];
+	if (w.affinity.size())
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : w.affinity)
+			CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (int cpu : w.affinity)
+		{
+			if (cpu < (int)(sizeof(DWORD_PTR) * 8))
+				mask |= ((DWORD_PTR)1) << cpu;
+		}
+		if (mask)
+			SetThreadAffinityMask(GetCurrentThread(), mask);
+#endif
+	}
+
+	for (;;)
+	{
+		task_ptr task = pop(index);
+		if (!task)
+			task = steal(index);
+		if (task)
+		{
+			task->run();
+			continue;
+		}
+
+		if (m_stopping.load(std::memory_order_seq_cst) && m_queued.load(std::memory_order_seq_cst) == 0)
+			break;
+
+		{
+			std::lock_guard<std::mutex> lock(m_idleLock);
+			m_idle.push_back(index);
+			m_idleCount.fetch_add(1, std::memory_order_seq_cst);
+		}
+		//work may have been queued before we were on the idle list, and nobody would wake us for it
+		if (m_queued.load(std::memory_order_seq_cst) || m_stopping.load(std::memory_order_seq_cst))
+		{
+			std::lock_guard<std::mutex> lock(m_idleLock);
+			auto it = std::find(m_idle.begin(), m_idle.end(), index);
+			if (it != m_idle.end())
+			{
+				m_idle.erase(it);
+				m_idleCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+			continue;
+		}
+		neosmart::WaitForEvent(w.wake);
+	}
+
+	t_pool = nullptr;
+	t_worker = -1;
+}
@@ -0,0 +1,432 @@
+/**
+ * validation_binary.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intel_check.h"
+#include "validation_binary.h"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace
+{
+	constexpr std::uint8_t magic[4] = { 'H', 'V', 'B', '1' };
+
+	constexpr std::uint8_t flag_minimum = 0x01;
+	constexpr std::uint8_t flag_maximum = 0x02;
+	constexpr std::uint8_t flag_units = 0x04;
+	constexpr std::uint8_t flag_message = 0x08;
+
+	constexpr std::uint8_t tag_int32 = 0;
+	constexpr std::uint8_t tag_double = 1;
+	constexpr std::uint8_t tag_string = 2;
+
+	void write_varint(std::vector<std::uint8_t>& out, std::uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<std::uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	/// <summary>
+	/// Decode a varint that has already been checked by binary_view's constructor.
+	/// </summary>
+	std::uint64_t read_varint(const std::uint8_t*& pos) noexcept
+	{
+		std::uint64_t value = 0;
+		int shift = 0;
+		while (*pos & 0x80)
+		{
+			value |= static_cast<std::uint64_t>(*pos++ & 0x7f) << shift;
+			shift += 7;
+		}
+		value |= static_cast<std::uint64_t>(*pos++) << shift;
+		return value;
+	}
+
+	const validation::validation_object& deref(const std::shared_ptr<validation::validation_object>& child) { return *child; }
+	const validation::validation_tree::node_ref& deref(const validation::validation_tree::node_ref& child) { return child; }
+
+	class binary_writer
+	{
+	public:
+		template<typename Node>
+		void write(const Node& node)
+		{
+			m_nodeCount++;
+			write_varint(m_body, id(node.protobufObject()));
+			m_body.push_back(static_cast<std::uint8_t>(node.errorLevel()));
+			write_varint(m_body, id(node.errorIdentifier()));
+			write_varint(m_body, node.objectName().size());
+			for (auto& name : node.objectName())
+				write_varint(m_body, id(name));
+			write_varint(m_body, node.errorValue().size());
+			for (auto& value : node.errorValue())
+				write_varint(m_body, id(value));
+
+			const auto& minimum = node.minimum();
+			const auto& maximum = node.maximum();
+			const auto& units = node.units();
+			const auto& message = node.errorMessage();
+			std::uint8_t flags = 0;
+			if (minimum.has_value())
+				flags |= flag_minimum;
+			if (maximum.has_value())
+				flags |= flag_maximum;
+			if (units.has_value())
+				flags |= flag_units;
+			if (message.has_value())
+				flags |= flag_message;
+			m_body.push_back(flags);
+			if (minimum.has_value())
+				write_range(*minimum);
+			if (maximum.has_value())
+				write_range(*maximum);
+			if (units.has_value())
+				write_varint(m_body, id(*units));
+			if (message.has_value())
+				write_varint(m_body, id(*message));
+
+			write_varint(m_body, node.child_count());
+			for (auto&& child : node.children())
+				write(deref(child));
+		}
+
+		std::vector<std::uint8_t> finish()
+		{
+			std::vector<std::uint8_t> out(std::begin(magic), std::end(magic));
+			write_varint(out, m_strings.size());
+			for (auto& str : m_strings)
+			{
+				write_varint(out, str.size());
+				out.insert(out.end(), str.begin(), str.end());
+			}
+			write_varint(out, m_nodeCount);
+			out.insert(out.end(), m_body.begin(), m_body.end());
+			return out;
+		}
+
+	private:
+		std::vector<std::uint8_t> m_body;
+		std::vector<std::string_view> m_strings;				// views of strings in the tree being written
+		std::unordered_map<std::string_view, std::uint32_t> m_ids;
+		std::uint64_t m_nodeCount{ 0 };
+
+		std::uint32_t id(std::string_view str)
+		{
+			auto it = m_ids.find(str);
+			if (it != m_ids.end())
+				return it->second;
+			std::uint32_t id = static_cast<std::uint32_t>(m_strings.size());
+			m_strings.push_back(str);
+			m_ids.emplace(str, id);
+			return id;
+		}
+
+		void write_range(const validation::range_type& range)
+		{
+			m_body.push_back(range.is_inclusive ? 1 : 0);
+			if (std::holds_alternative<std::int32_t>(range.value))
+			{
+				m_body.push_back(tag_int32);
+				std::int32_t value = std::get<std::int32_t>(range.value);
+				write_varint(m_body, (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31));
+			}
+			else if (std::holds_alternative<double>(range.value))
+			{
+				m_body.push_back(tag_double);
+				std::uint64_t bits;
+				double value = std::get<double>(range.value);
+				std::memcpy(&bits, &value, sizeof(bits));
+				for (int i = 0; i < 8; i++)
+					m_body.push_back(static_cast<std::uint8_t>(bits >> (i * 8)));
+			}
+			else
+			{
+				m_body.push_back(tag_string);
+				write_varint(m_body, id(std::get<std::string>(range.value)));
+			}
+		}
+	};
+
+	/// <summary>
+	/// Bounds checked reading, only used while checking the data.
+	/// </summary>
+	class checked_reader
+	{
+	public:
+		checked_reader(const std::uint8_t* data, size_t size) noexcept : m_data(data), m_pos(data), m_end(data + size) { }
+
+		std::uint32_t offset() const noexcept { return static_cast<std::uint32_t>(m_pos - m_data); }
+		const std::uint8_t* pos() const noexcept { return m_pos; }
+
+		std::uint8_t byte()
+		{
+			if (m_pos >= m_end)
+				fail();
+			return *m_pos++;
+		}
+
+		std::uint64_t varint()
+		{
+			std::uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				std::uint8_t b = byte();
+				value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+				if (!(b & 0x80))
+					return value;
+			}
+			fail();
+		}
+
+		std::uint32_t index(size_t count)
+		{
+			std::uint64_t value = varint();
+			if (value >= count)
+				fail();
+			return static_cast<std::uint32_t>(value);
+		}
+
+		void skip(size_t count)
+		{
+			if (static_cast<size_t>(m_end - m_pos) < count)
+				fail();
+			m_pos += count;
+		}
+
+		[[noreturn]] static void fail()
+		{
+			throw std::invalid_argument("Invalid binary validation data");
+		}
+
+	private:
+		const std::uint8_t* m_data;
+		const std::uint8_t* m_pos;
+		const std::uint8_t* m_end;
+	};
+}
+
+
+std::vector<std::uint8_t> validation::serialize_binary(const validation_object& root)
+{
+	binary_writer writer;
+	writer.write(root);
+	return writer.finish();
+}
+
+
+std::vector<std::uint8_t> validation::serialize_binary(const validation_tree& tree)
+{
+	binary_writer writer;
+	writer.write(tree.root());
+	return writer.finish();
+}
+
+
+validation::binary_view::binary_view(const std::uint8_t* data, size_t size)
+	: m_data(data)
+{
+	if (size > UINT32_MAX)
+		checked_reader::fail();
+	checked_reader reader(data, size);
+	for (auto c : magic)
+		if (reader.byte() != c)
+			checked_reader::fail();
+
+	std::uint64_t string_count = reader.varint();
+	if (string_count > size)
+		checked_reader::fail();
+	m_strings.reserve(static_cast<size_t>(string_count));
+	for (std::uint64_t i = 0; i < string_count; i++)
+	{
+		std::uint64_t length = reader.varint();
+		if (length > size)
+			checked_reader::fail();
+		const char* str = reinterpret_cast<const char*>(reader.pos());
+		reader.skip(static_cast<size_t>(length));
+		m_strings.emplace_back(str, static_cast<size_t>(length));
+	}
+
+	std::uint64_t node_count = reader.varint();
+	if ((node_count == 0) || (node_count > size))
+		checked_reader::fail();
+	m_entries.resize(static_cast<size_t>(node_count));
+
+	auto skip_range = [&reader, this]()
+	{
+		std::uint32_t offset = reader.offset();
+		if (reader.byte() > 1)
+			checked_reader::fail();
+		switch (reader.byte())
+		{
+		case tag_int32:
+			if (reader.varint() > UINT32_MAX)
+				checked_reader::fail();
+			break;
+		case tag_double:
+			reader.skip(8);
+			break;
+		case tag_string:
+			reader.index(m_strings.size());
+			break;
+		default:
+			checked_reader::fail();
+		}
+		return offset;
+	};
+
+	// the nodes whose children haven't all been read yet, and how many are left
+	std::vector<std::pair<std::uint32_t, std::uint64_t>> open;
+	for (std::uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		if ((i > 0) && open.empty())
+			checked_reader::fail();					// more than one root
+		if (!open.empty())
+			open.back().second--;
+
+		auto& entry = m_entries[i];
+		entry.protobuf_object = reader.index(m_strings.size());
+		std::uint8_t level = reader.byte();
+		if (level > static_cast<std::uint8_t>(error_level::SEVERE))
+			checked_reader::fail();
+		entry.level = static_cast<error_level>(level);
+		entry.error_identifier = reader.index(m_strings.size());
+
+		entry.name_count = reader.index(size);
+		entry.names = reader.offset();
+		for (std::uint32_t j = 0; j < entry.name_count; j++)
+			reader.index(m_strings.size());
+		entry.value_count = reader.index(size);
+		entry.values = reader.offset();
+		for (std::uint32_t j = 0; j < entry.value_count; j++)
+			reader.index(m_strings.size());
+
+		std::uint8_t flags = reader.byte();
+		entry.minimum = (flags & flag_minimum) ? skip_range() : none;
+		entry.maximum = (flags & flag_maximum) ? skip_range() : none;
+		entry.units = (flags & flag_units) ? reader.index(m_strings.size()) : none;
+		entry.error_message = (flags & flag_message) ? reader.index(m_strings.size()) : none;
+
+		std::uint64_t child_count = reader.varint();
+		if (child_count > node_count)
+			checked_reader::fail();
+		entry.child_count = static_cast<std::uint32_t>(child_count);
+		if (child_count)
+			open.emplace_back(i, child_count);
+		else
+		{
+			entry.end = i + 1;
+			while (!open.empty() && !open.back().second)
+			{
+				m_entries[open.back().first].end = i + 1;
+				open.pop_back();
+			}
+		}
+	}
+	if (!open.empty())
+		checked_reader::fail();					// ran out of nodes before all the children were read
+}
+
+
+std::optional<validation::range_type_view> validation::binary_view::range(std::uint32_t offset) const noexcept
+{
+	if (offset == none)
+		return std::nullopt;
+	const std::uint8_t* pos = m_data + offset;
+	range_type_view range;
+	range.is_inclusive = *pos++ != 0;
+	switch (*pos++)
+	{
+	case tag_int32:
+	{
+		std::uint32_t value = static_cast<std::uint32_t>(read_varint(pos));
+		range.value = static_cast<std::int32_t>((value >> 1) ^ (~(value & 1) + 1));
+		break;
+	}
+	case tag_double:
+	{
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 8; i++)
+			bits |= static_cast<std::uint64_t>(pos[i]) << (i * 8);
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		range.value = value;
+		break;
+	}
+	default:
+		range.value = m_strings[static_cast<size_t>(read_varint(pos))];
+		break;
+	}
+	return range;
+}
+
+
+std::optional<std::string_view> validation::binary_view::optional_string(std::uint32_t id) const noexcept
+{
+	if (id == none)
+		return std::nullopt;
+	return m_strings[id];
+}
+
+
+validation::error_level validation::binary_view::node::max_error_level() const noexcept
+{
+	// a branch is contiguous in preorder
+	auto level = error_level::NONE;
+	for (std::uint32_t i = m_index; (i < entry().end) && (level < error_level::SEVERE); i++)
+		if (m_view->m_entries[i].level > level)
+			level = m_view->m_entries[i].level;
+	return level;
+}
+
+
+validation::binary_view::node validation::binary_view::node::operator[](std::uint32_t index) const noexcept
+{
+	std::uint32_t child = m_index + 1;
+	while (index--)
+		child = m_view->m_entries[child].end;
+	return node(m_view, child);
+}
+
+
+std::string_view validation::binary_view::string_list::iterator::operator*() const noexcept
+{
+	const std::uint8_t* pos = m_pos;
+	return m_view->m_strings[static_cast<size_t>(read_varint(pos))];
+}
+
+
+validation::binary_view::string_list::iterator& validation::binary_view::string_list::iterator::operator++() noexcept
+{
+	read_varint(m_pos);
+	m_remaining--;
+	return *this;
+}
+
+
+std::string_view validation::binary_view::string_list::operator[](size_t index) const noexcept
+{
+	auto it = begin();
+	while (index--)
+		++it;
+	return *it;
+}
@@ -18,45 +18,73 @@
 
 #include "intel_check.h"
 #include "validation_object.h"
+#include "validation_sink.h"
 #include "types.h"
 #include <algorithm>
 #include <memory>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 
-validation::error_level validation::validation_object::recursive_max_error_level(const std::list<std::shared_ptr<validation::validation_object>>& list) noexcept
+const std::string& validation::intern_string(std::string_view str)
 {
-	auto level = error_level::NONE;
-	for (auto& child : list)
+	static std::deque<std::string> s_strings;				// a deque so the strings never move
+	static std::unordered_map<std::string_view, const std::string*> s_index;
+	static std::shared_mutex s_lock;
+
 	{
-		const auto l = child->max_error_level();
-		if (l > level)
-		{
-			level = l;
-			if (level >= error_level::SEVERE)
-				break;
-		}
+		std::shared_lock<std::shared_mutex> lock(s_lock);
+		auto it = s_index.find(str);
+		if (it != s_index.end())
+			return *it->second;
 	}
-	return level;
+
+	std::unique_lock<std::shared_mutex> lock(s_lock);
+	auto it = s_index.find(str);							// another thread may have added it between the locks
+	if (it != s_index.end())
+		return *it->second;
+	const std::string& interned = s_strings.emplace_back(str);
+	s_index.emplace(interned, &interned);
+	return interned;
 }
 
 
 validation::error_level validation::validation_object::max_error_level() const noexcept
 {
-	if (m_childValidation.size() == 0)
-		return m_errorLevel;
-	const auto level = recursive_max_error_level(m_childValidation);
-	if (level > m_errorLevel)		// getting rid of std::max to avoid non-standard MSVC crap
-		return level;
-	return m_errorLevel;
+	if (m_levelCounts[static_cast<size_t>(error_level::SEVERE)])
+		return error_level::SEVERE;
+	if (m_levelCounts[static_cast<size_t>(error_level::WARNING)])
+		return error_level::WARNING;
+	if (m_levelCounts[static_cast<size_t>(error_level::INFORMATION)])
+		return error_level::INFORMATION;
+	return error_level::NONE;
+}
+
+
+void validation::validation_object::propagate_counts(const size_t(&counts)[4], bool add) noexcept
+{
+	for (auto parent = m_parent; parent; parent = parent->m_parent)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			if (add)
+				parent->m_levelCounts[i] += counts[i];
+			else
+				parent->m_levelCounts[i] -= counts[i];
+		}
+	}
 }
 
 
 validation::validation_object::validation_object(const std::string& protobufObject, const std::string& name)
-	: m_protobufObject(protobufObject)
+	: m_errorIdentifier(&intern_string("")),
+	  m_protobufObject(&intern_string(protobufObject))
 {
 	if (name.length())
 		m_objectName.push_back(name);
-	if (!m_protobufObject.size()) {
+	if (!m_protobufObject->size()) {
 		weak_assert(false);
 		throw std::invalid_argument("Validation nodes must have a protobuf type name");
 	}
@@ -69,10 +97,11 @@ validation::validation_object::validation_object(const std::string& protobufObje
 
 
 validation::validation_object::validation_object(const std::string& protobufObject, std::initializer_list<std::string>&& names)
-	: m_protobufObject(protobufObject),
+	: m_errorIdentifier(&intern_string("")),
+	  m_protobufObject(&intern_string(protobufObject)),
 	  m_objectName(std::forward<decltype(names)>(names))
 {
-	if (!m_protobufObject.size()) {
+	if (!m_protobufObject->size()) {
 		weak_assert(false);
 		throw std::invalid_argument("Validation nodes must have a protobuf type name");
 	}
@@ -84,28 +113,143 @@ validation::validation_object::validation_object(const std::string& protobufObje
 }
 
 
+validation::validation_object::validation_object(validation_object&& other) noexcept
+	: m_errorLevel(other.m_errorLevel),
+	  m_errorIdentifier(other.m_errorIdentifier),
+	  m_protobufObject(other.m_protobufObject),
+	  m_errorValue(std::move(other.m_errorValue)),
+	  m_objectName(std::move(other.m_objectName)),
+	  m_childValidation(std::move(other.m_childValidation)),
+	  m_min(std::move(other.m_min)),
+	  m_max(std::move(other.m_max)),
+	  m_units(std::move(other.m_units)),
+	  m_errorMessage(std::move(other.m_errorMessage)),
+	  m_sink(other.m_sink)
+{
+	std::copy(std::begin(other.m_levelCounts), std::end(other.m_levelCounts), std::begin(m_levelCounts));
+	for (auto& child : m_childValidation)
+		child->m_parent = this;
+
+	other.reset_moved();
+}
+
+
+validation::validation_object& validation::validation_object::operator=(validation_object&& other) noexcept
+{
+	if (this != &other)
+	{
+		propagate_counts(m_levelCounts, false);
+		for (auto& child : m_childValidation)
+			child->m_parent = nullptr;
+
+		m_errorLevel = other.m_errorLevel;
+		m_errorIdentifier = other.m_errorIdentifier;
+		m_protobufObject = other.m_protobufObject;
+		m_errorValue = std::move(other.m_errorValue);
+		m_objectName = std::move(other.m_objectName);
+		m_childValidation = std::move(other.m_childValidation);
+		m_min = std::move(other.m_min);
+		m_max = std::move(other.m_max);
+		m_units = std::move(other.m_units);
+		m_errorMessage = std::move(other.m_errorMessage);
+		m_sink = other.m_sink;
+		std::copy(std::begin(other.m_levelCounts), std::end(other.m_levelCounts), std::begin(m_levelCounts));
+		for (auto& child : m_childValidation)
+			child->m_parent = this;
+		propagate_counts(m_levelCounts, true);
+
+		other.reset_moved();
+	}
+	return *this;
+}
+
+
+void validation::validation_object::reset_moved() noexcept
+{
+	// the moved branch no longer belongs to this node's parent, if it had one, but this node is still a child
+	// of it so is counted again as an empty node with no error
+	propagate_counts(m_levelCounts, false);
+	m_errorLevel = error_level::NONE;
+	std::fill(std::begin(m_levelCounts), std::end(m_levelCounts), 0);
+	m_levelCounts[static_cast<size_t>(error_level::NONE)] = 1;
+	propagate_counts(m_levelCounts, true);
+}
+
+
 validation::validation_object::~validation_object()
 {
+	// children may outlive this node if someone has locked one of them
+	for (auto& child : m_childValidation)
+		child->m_parent = nullptr;
 	m_childValidation.clear();
 }
 
 
-void validation::validation_object::make_error(error_level level, std::string_view errorIdentifier, const std::string& value)
+bool validation::validation_object::should_abort() const noexcept
+{
+	return m_sink && m_sink->should_abort();
+}
+
+
+void validation::validation_object::validate(const std::string& protobufObject, const std::string* names, size_t name_count, std::string_view errorIdentifier,
+	size_t value_count)
+{
+	if (!protobufObject.size()) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have a protobuf type name");
+	}
+	if (!name_count || std::any_of(names, names + name_count, [](const std::string& name) { return name.size() == 0; })) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have an object name");
+	}
+	if (!errorIdentifier.size())
+		throw std::invalid_argument("Validation nodes must have an error identifier");
+	if (name_count != value_count)
+		throw std::invalid_argument("The number of values did not match the number of object names.");
+}
+
+
+bool validation::validation_object::report(const std::string& protobufObject, const std::string* names, size_t name_count, error_level level, std::string_view errorIdentifier,
+	const std::string* values, size_t value_count, std::string_view errorMessage) const
 {
+	if (!m_sink)
+		return true;
+	validation_event event{ this, protobufObject, errorIdentifier, level, names, name_count, values, value_count, errorMessage };
+	return m_sink->raise(event);
+}
+
+
+void validation::validation_object::set_error_level(error_level level) noexcept
+{
+	if (level == m_errorLevel)
+		return;
+	size_t removed[4]{ 0, 0, 0, 0 }, added[4]{ 0, 0, 0, 0 };
+	removed[static_cast<size_t>(m_errorLevel)] = 1;
+	added[static_cast<size_t>(level)] = 1;
+	m_levelCounts[static_cast<size_t>(m_errorLevel)]--;
+	m_levelCounts[static_cast<size_t>(level)]++;
+	propagate_counts(removed, false);
+	propagate_counts(added, true);
 	m_errorLevel = level;
-	m_errorIdentifier = errorIdentifier;
-	if (!m_errorIdentifier.size())
+}
+
+
+void validation::validation_object::make_error(error_level level, std::string_view errorIdentifier, const std::string& value)
+{
+	if (!errorIdentifier.size())
 		throw std::invalid_argument("Validation nodes must have an error identifier");
+	set_error_level(level);
+	m_errorIdentifier = &intern_string(errorIdentifier);
 	m_errorValue.push_back(value);
 }
 
 
 void validation::validation_object::make_error(error_level level, std::string_view errorIdentifier, std::initializer_list<std::string>&& value)
 {
-	m_errorLevel = level;
-	m_errorIdentifier = errorIdentifier;
-	if (!m_errorIdentifier.size())
+	if (!errorIdentifier.size())
 		throw std::invalid_argument("Validation nodes must have an error identifier");
+	set_error_level(level);
+	m_errorIdentifier = &intern_string(errorIdentifier);
 	m_errorValue.insert(m_errorValue.end(), std::forward<decltype(value)>(value));
 }
 
@@ -113,13 +257,20 @@ void validation::validation_object::make_error(error_level level, std::string_vi
 std::weak_ptr<validation::validation_object> validation::validation_object::add_child_validation(validation_object&& child)
 {
 	m_childValidation.push_back(std::make_shared<validation::validation_object>(std::forward<decltype(child)>(child)));
-	return m_childValidation.back();
+	auto& added = m_childValidation.back();
+	added->m_parent = this;
+	added->m_sink = m_sink;
+	added->propagate_counts(added->m_levelCounts, true);
+	return added;
 }
 
 
 std::weak_ptr<validation::validation_object> validation::validation_object::add_child_validation(const std::string& protobufObject, const std::string& name,
 	error_level level, std::string_view errorIdentifier, const std::string& value)
 {
+	validate(protobufObject, &name, 1, errorIdentifier, 1);
+	if (!report(protobufObject, &name, 1, level, errorIdentifier, &value, 1, {}))
+		return {};
 	validation::validation_object v(protobufObject, name);
 	v.make_error(level, errorIdentifier, value);
 	return add_child_validation(std::move(v));
@@ -129,10 +280,11 @@ std::weak_ptr<validation::validation_object> validation::validation_object::add_
 std::weak_ptr<validation::validation_object> validation::validation_object::add_child_validation(const std::string& protobufObject, std::initializer_list<std::string>&& names,
 	error_level level, std::string_view errorIdentifier, std::initializer_list<std::string>&& values)
 {
+	validate(protobufObject, names.begin(), names.size(), errorIdentifier, values.size());
+	if (!report(protobufObject, names.begin(), names.size(), level, errorIdentifier, values.begin(), values.size(), {}))
+		return {};
 	validation::validation_object v(protobufObject, std::forward<decltype(names)>(names));
 	v.make_error(level, errorIdentifier, std::forward<decltype(values)>(values));
-	if (v.m_objectName.size() != v.m_errorValue.size())
-		throw std::invalid_argument("The number of values did not match the number of object names.");
 	return add_child_validation(std::move(v));
 }
 
@@ -140,6 +292,9 @@ std::weak_ptr<validation::validation_object> validation::validation_object::add_
 std::weak_ptr<validation::validation_object> validation::validation_object::add_child_validation(const std::string& protobufObject, const std::string& name,
 	error_level level, std::string_view errorIdentifier, const std::string& value, const std::string& errorMessage)
 {
+	validate(protobufObject, &name, 1, errorIdentifier, 1);
+	if (!report(protobufObject, &name, 1, level, errorIdentifier, &value, 1, errorMessage))
+		return {};
 	validation::validation_object v(protobufObject, name);
 	v.make_error(level, errorIdentifier, value);
 	v.m_errorMessage = std::make_optional(errorMessage);
@@ -150,11 +305,12 @@ std::weak_ptr<validation::validation_object> validation::validation_object::add_
 std::weak_ptr<validation::validation_object> validation::validation_object::add_child_validation(const std::string& protobufObject, std::initializer_list<std::string>&& names,
 	error_level level, std::string_view errorIdentifier, std::initializer_list<std::string>&& values, const std::string& errorMessage)
 {
+	validate(protobufObject, names.begin(), names.size(), errorIdentifier, values.size());
+	if (!report(protobufObject, names.begin(), names.size(), level, errorIdentifier, values.begin(), values.size(), errorMessage))
+		return {};
 	validation::validation_object v(protobufObject, std::forward<decltype(names)>(names));
 	v.make_error(level, errorIdentifier, std::forward<decltype(values)>(values));
 	v.m_errorMessage = std::make_optional(errorMessage);
-	if (v.m_objectName.size() != v.m_errorValue.size())
-		throw std::invalid_argument("The number of values did not match the number of object names.");
 	return add_child_validation(std::move(v));
 }
 
@@ -163,6 +319,9 @@ std::weak_ptr<validation::validation_object> validation::validation_object::add_
 	validation::error_level level, std::string_view errorIdentifier, const std::string& value,
 	validation::range_type minimum, validation::range_type maximum, const std::string& units, const std::string& errorMessage)
 {
+	validate(protobufObject, &name, 1, errorIdentifier, 1);
+	if (!report(protobufObject, &name, 1, level, errorIdentifier, &value, 1, errorMessage))
+		return {};
 	validation::validation_object v(protobufObject, name);
 	v.make_error(level, errorIdentifier, value);
 	v.m_min = std::make_optional(minimum);
@@ -178,3 +337,59 @@ std::weak_ptr<validation::validation_object> validation::validation_object::add_
 	validation::validation_object v(protobufObject, name);
 	return add_child_validation(std::move(v));
 }
+
+
+void validation::validation_object::merge_children(validation_object&& source)
+{
+	if (&source == this || source.m_childValidation.empty())
+		return;
+
+	// the counts for source's children, which is source's branch without source itself
+	size_t counts[4];
+	std::copy(std::begin(source.m_levelCounts), std::end(source.m_levelCounts), std::begin(counts));
+	counts[static_cast<size_t>(source.m_errorLevel)]--;
+
+	for (auto& child : source.m_childValidation)
+		child->m_parent = this;
+	m_childValidation.insert(m_childValidation.end(), std::make_move_iterator(source.m_childValidation.begin()), std::make_move_iterator(source.m_childValidation.end()));
+	source.m_childValidation.clear();
+
+	source.propagate_counts(counts, false);
+	std::fill(std::begin(source.m_levelCounts), std::end(source.m_levelCounts), 0);
+	source.m_levelCounts[static_cast<size_t>(source.m_errorLevel)] = 1;
+
+	for (size_t i = 0; i < 4; i++)
+		m_levelCounts[i] += counts[i];
+	propagate_counts(counts, true);
+}
+
+
+validation::concurrent_collector::concurrent_collector(validation_object* parent, size_t slots)
+	: m_parent(parent),
+	  m_slotCount(slots)
+{
+	if (m_parent)
+	{
+		m_slots.reserve(slots);
+		for (size_t i = 0; i < slots; i++)
+		{
+			m_slots.emplace_back(m_parent->protobufObject(), "concurrent_collector");
+			m_slots.back().set_sink(m_parent->sink());
+		}
+	}
+}
+
+
+validation::concurrent_collector::~concurrent_collector()
+{
+	merge();
+}
+
+
+void validation::concurrent_collector::merge()
+{
+	if (!m_parent)
+		return;
+	for (auto& slot : m_slots)
+		m_parent->merge_children(std::move(slot));
+}
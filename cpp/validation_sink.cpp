@@ -0,0 +1,69 @@
+/**
+ * validation_sink.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intel_check.h"
+#include "validation_sink.h"
+
+
+bool validation::validation_sink::raise(const validation_event& event)
+{
+	if (event.level < m_minLevel)
+		return false;
+	if (m_abortOnSevere && (event.level >= error_level::SEVERE))
+		request_abort();
+	on_error(event);
+	return m_materialize;
+}
+
+
+void validation::counting_sink::on_error(const validation_event& event)
+{
+	m_counts[static_cast<size_t>(event.level)].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void validation::callback_sink::on_error(const validation_event& event)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_callback(event);
+}
+
+
+void validation::stream_sink::on_error(const validation_event& event)
+{
+	static const char* const levels[] = { "NONE", "INFORMATION", "WARNING", "SEVERE" };
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_stream << levels[static_cast<size_t>(event.level)] << ' ' << event.protobufObject << " [";
+	for (size_t i = 0; i < event.name_count; i++)
+	{
+		if (i)
+			m_stream << ", ";
+		m_stream << event.names[i];
+	}
+	m_stream << "] " << event.errorIdentifier << " = ";
+	for (size_t i = 0; i < event.value_count; i++)
+	{
+		if (i)
+			m_stream << ", ";
+		m_stream << event.values[i];
+	}
+	if (event.errorMessage.size())
+		m_stream << " (" << event.errorMessage << ')';
+	m_stream << '\n';
+}
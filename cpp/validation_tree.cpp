@@ -0,0 +1,295 @@
+/**
+ * validation_tree.cpp
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "intel_check.h"
+#include "validation_tree.h"
+#include "types.h"
+#include <algorithm>
+
+
+validation::validation_tree::validation_tree(std::string_view protobufObject, std::string_view name)
+{
+	std::uint32_t names = intern_list({ name });
+	add_node(invalid_node, protobufObject, names, 1);
+}
+
+
+validation::validation_tree::validation_tree(const validation_object& root)
+{
+	std::uint32_t names_offset = (std::uint32_t)m_stringLists.size();
+	for (auto& name : root.objectName())
+		m_stringLists.push_back(intern(name));
+	node_index index = add_node(invalid_node, root.protobufObject(), names_offset, (std::uint32_t)root.objectName().size());
+	copy_error(index, root);
+	copy_children(index, root);
+}
+
+
+void validation::validation_tree::copy_children(node_index parent, const validation_object& source)
+{
+	for (auto& child : source.children())
+	{
+		std::uint32_t names_offset = (std::uint32_t)m_stringLists.size();
+		for (auto& name : child->objectName())
+			m_stringLists.push_back(intern(name));
+		node_index index = add_node(parent, child->protobufObject(), names_offset, (std::uint32_t)child->objectName().size());
+		copy_error(index, *child);
+		copy_children(index, *child);
+	}
+}
+
+
+void validation::validation_tree::copy_error(node_index index, const validation_object& source)
+{
+	std::uint32_t error_identifier = intern(source.errorIdentifier());
+	std::uint32_t values_offset = (std::uint32_t)m_stringLists.size();
+	for (auto& value : source.errorValue())
+		m_stringLists.push_back(intern(value));
+
+	auto& node = m_nodes[index];
+	node.level = source.errorLevel();
+	node.error_identifier = error_identifier;
+	node.values_offset = values_offset;
+	node.values_count = (std::uint32_t)source.errorValue().size();
+	if (source.units().has_value())
+		node.units = intern(source.units().value());
+	if (source.errorMessage().has_value())
+		node.error_message = intern(source.errorMessage().value());
+	if (source.minimum().has_value() || source.maximum().has_value())
+	{
+		node.range = (std::uint32_t)m_ranges.size();
+		m_ranges.push_back({ source.minimum(), source.maximum() });
+	}
+}
+
+
+void validation::validation_tree::reserve(size_t node_count)
+{
+	m_nodes.reserve(node_count);
+	m_stringLists.reserve(node_count * 2);
+}
+
+
+std::uint32_t validation::validation_tree::intern(std::string_view str)
+{
+	auto it = m_stringIds.find(str);
+	if (it != m_stringIds.end())
+		return it->second;
+	std::uint32_t id = (std::uint32_t)m_strings.size();
+	m_strings.emplace_back(str);
+	m_stringIds.emplace(m_strings.back(), id);
+	return id;
+}
+
+
+std::uint32_t validation::validation_tree::intern_list(std::initializer_list<std::string_view> strs)
+{
+	std::uint32_t offset = (std::uint32_t)m_stringLists.size();
+	for (auto& str : strs)
+		m_stringLists.push_back(intern(str));
+	return offset;
+}
+
+
+std::optional<std::string_view> validation::validation_tree::optional_string(std::uint32_t id) const
+{
+	if (id == no_string)
+		return std::nullopt;
+	return std::string_view(m_strings[id]);
+}
+
+
+const validation::validation_tree::range_pair& validation::validation_tree::range(node_index index) const noexcept
+{
+	static const range_pair empty;
+	std::uint32_t range = m_nodes[index].range;
+	if (range == no_range)
+		return empty;
+	return m_ranges[range];
+}
+
+
+validation::error_level validation::validation_tree::max_error_level(node_index index) const noexcept
+{
+	// children always come after their parent, but not necessarily before the next sibling of their parent
+	// so walk the subtree with the sibling links rather than scanning a range of the array
+	auto level = m_nodes[index].level;
+	node_index current = m_nodes[index].first_child;
+	while ((current != invalid_node) && (level < error_level::SEVERE))
+	{
+		const auto& node = m_nodes[current];
+		if (node.level > level)
+			level = node.level;
+
+		if (node.first_child != invalid_node)
+			current = node.first_child;
+		else
+		{
+			// move to the next sibling of the closest ancestor that has one, without leaving the subtree
+			while ((current != index) && (m_nodes[current].next_sibling == invalid_node))
+				current = m_nodes[current].parent;
+			current = (current == index) ? invalid_node : m_nodes[current].next_sibling;
+		}
+	}
+	return level;
+}
+
+
+validation::node_index validation::validation_tree::add_node(node_index parent, std::string_view protobufObject, std::uint32_t names_offset, std::uint32_t names_count)
+{
+	if (!protobufObject.size()) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have a protobuf type name");
+	}
+	//check that an object name was passed and that none of the object names are empty
+	if (!names_count || std::any_of(m_stringLists.begin() + names_offset, m_stringLists.begin() + names_offset + names_count, [this](std::uint32_t name) { return m_strings[name].size() == 0; })) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have an object name");
+	}
+	if ((parent != invalid_node) && (parent >= m_nodes.size()))
+		throw std::out_of_range("Invalid parent validation node");
+
+	node_type node;
+	node.parent = parent;
+	node.first_child = invalid_node;
+	node.last_child = invalid_node;
+	node.next_sibling = invalid_node;
+	node.child_count = 0;
+	node.protobuf_object = intern(protobufObject);
+	node.error_identifier = intern("");
+	node.names_offset = names_offset;
+	node.names_count = names_count;
+	node.values_offset = 0;
+	node.values_count = 0;
+	node.units = no_string;
+	node.error_message = no_string;
+	node.range = no_range;
+	node.level = error_level::NONE;
+
+	node_index index = (node_index)m_nodes.size();
+	m_nodes.push_back(node);
+	if (parent != invalid_node)
+	{
+		auto& p = m_nodes[parent];
+		if (p.last_child == invalid_node)
+			p.first_child = index;
+		else
+			m_nodes[p.last_child].next_sibling = index;
+		p.last_child = index;
+		p.child_count++;
+	}
+	return index;
+}
+
+
+void validation::validation_tree::check_node(node_index parent, std::string_view protobufObject, std::initializer_list<std::string_view> names) const
+{
+	if (!protobufObject.size()) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have a protobuf type name");
+	}
+	if (!names.size() || std::any_of(names.begin(), names.end(), [](std::string_view name) { return name.size() == 0; })) {
+		weak_assert(false);
+		throw std::invalid_argument("Validation nodes must have an object name");
+	}
+	if ((parent != invalid_node) && (parent >= m_nodes.size()))
+		throw std::out_of_range("Invalid parent validation node");
+}
+
+
+void validation::validation_tree::check_error(std::string_view errorIdentifier)
+{
+	if (!errorIdentifier.size())
+		throw std::invalid_argument("Validation nodes must have an error identifier");
+}
+
+
+void validation::validation_tree::make_error(node_index index, error_level level, std::string_view errorIdentifier, std::uint32_t values_offset, std::uint32_t values_count)
+{
+	auto& node = m_nodes[index];
+	node.level = level;
+	node.error_identifier = intern(errorIdentifier);
+	node.values_offset = values_offset;
+	node.values_count = values_count;
+}
+
+
+validation::node_index validation::validation_tree::add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name)
+{
+	// check before interning anything so a rejected node leaves no strings behind
+	check_node(parent, protobufObject, { name });
+	return add_node(parent, protobufObject, intern_list({ name }), 1);
+}
+
+
+validation::node_index validation::validation_tree::add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name,
+	error_level level, std::string_view errorIdentifier, std::string_view value)
+{
+	// validate everything before any strings are interned or the node is linked into its parent, so a throw
+	// leaves the tree unchanged
+	check_node(parent, protobufObject, { name });
+	check_error(errorIdentifier);
+	node_index index = add_node(parent, protobufObject, intern_list({ name }), 1);
+	make_error(index, level, errorIdentifier, intern_list({ value }), 1);
+	return index;
+}
+
+
+validation::node_index validation::validation_tree::add_child_validation(node_index parent, std::string_view protobufObject, std::initializer_list<std::string_view> names,
+	error_level level, std::string_view errorIdentifier, std::initializer_list<std::string_view> values)
+{
+	check_node(parent, protobufObject, names);
+	check_error(errorIdentifier);
+	if (names.size() != values.size())
+		throw std::invalid_argument("The number of values did not match the number of object names.");
+	node_index index = add_node(parent, protobufObject, intern_list(names), (std::uint32_t)names.size());
+	make_error(index, level, errorIdentifier, intern_list(values), (std::uint32_t)values.size());
+	return index;
+}
+
+
+validation::node_index validation::validation_tree::add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name,
+	error_level level, std::string_view errorIdentifier, std::string_view value, std::string_view errorMessage)
+{
+	node_index index = add_child_validation(parent, protobufObject, name, level, errorIdentifier, value);
+	m_nodes[index].error_message = intern(errorMessage);
+	return index;
+}
+
+
+validation::node_index validation::validation_tree::add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name,
+	error_level level, std::string_view errorIdentifier, std::string_view value,
+	range_type minimum, range_type maximum, std::string_view units, std::string_view errorMessage)
+{
+	node_index index = add_child_validation(parent, protobufObject, name, level, errorIdentifier, value);
+	auto& node = m_nodes[index];
+	node.units = intern(units);
+	node.error_message = intern(errorMessage);
+	node.range = (std::uint32_t)m_ranges.size();
+	m_ranges.push_back({ std::move(minimum), std::move(maximum) });
+	return index;
+}
+
+
+validation::validation_tree::node_ref validation::validation_tree::node_ref::operator[](std::uint32_t index) const noexcept
+{
+	node_index child = node().first_child;
+	while (index--)
+		child = m_tree->m_nodes[child].next_sibling;
+	return node_ref(m_tree, child);
+}
@@ -19,13 +19,37 @@
 #pragma once
 
 #include <boost/property_tree/ptree.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <thread>
 
 class IniSettings
 {
 public:
-    IniSettings(bool saveOnWrite = true);
+    //bytes in the blob store, valid for as long as the settings are
+    struct BlobView
+    {
+        const std::uint8_t* data = nullptr;
+        std::uint32_t size = 0;
+
+        const std::uint8_t* begin() const { return data; }
+        const std::uint8_t* end() const { return data + size; }
+        bool empty() const { return size == 0; }
+    };
+
+    //lazy reads the file in and only finds where each top level group is, groups are parsed when
+    //they're first read or written (or when the settings are saved)
+    IniSettings(bool saveOnWrite = true, bool lazy = false);
+    //use a settings file other than ~/.prometheus/settings.info
+    IniSettings(const std::string &path, bool saveOnWrite, bool lazy = false);
+    //writes out anything still waiting on the write-behind delay
+    ~IniSettings();
 
     void WriteProfileInt(const std::string &group_name, const std::string &key, int value);
     void WriteProfileLong(const std::string &group_name, const std::string &key, unsigned long value);
@@ -34,6 +58,9 @@ public:
     void WriteProfileString(const std::string &group_name, const std::string &key, std::string value);
     void WriteProfileBOOL(const std::string &group_name, const std::string &key, bool value);
     void WriteProfileBinary(const std::string &group_name, const std::string &key, std::uint8_t* data, std::uint32_t len);
+    //keep the bytes in a memory mapped store next to the settings file, the settings only hold a
+    //reference to them, identical blobs are only stored once
+    void WriteProfileBlob(const std::string &group_name, const std::string &key, const std::uint8_t* data, std::uint32_t len);
 
     int GetProfileInt(const std::string &group_name, const std::string &key, int def);
     unsigned long GetProfileLong(const std::string &group_name, const std::string &key, unsigned long def);
@@ -42,6 +69,8 @@ public:
     std::string GetProfileString(const std::string &group_name, const std::string &key, std::string def);
     bool GetProfileBOOL(const std::string &group_name, const std::string &key, bool def);
     void GetProfileBinary(const std::string &group_name, const std::string &key, std::uint8_t** data, std::uint32_t* len);
+    //the bytes of a value written by WriteProfileBlob without copying them, empty if the value isn't a blob
+    BlobView GetProfileBlob(const std::string &group_name, const std::string &key);
 
 
     void WriteRegistryInt(const std::string &group_name, const std::string &key, int value);
@@ -50,15 +79,74 @@ public:
     int GetRegistryInt(const std::string &group_name, const std::string &key, int def);
     std::string GetRegistryString(const std::string &group_name, const std::string &key, std::string def);
     
-    void Save();
+    //sync flushes the new file to disk before it replaces the settings, saving on every write skips
+    //that and only the write-behind thread, Flush and the destructor pay for it
+    void Save(bool sync = true);
+    //save only if there are writes that haven't been saved yet
+    void Flush();
+    //instead of rewriting the file on every write, save from a background thread once no
+    //write has been made for delay (or at most 10 times delay after the first unsaved write),
+    //0 to go back to saving on every write
+    void SetWriteBehind(std::chrono::milliseconds delay);
     
     std::string GetPath();
 
 private:
+    //every value in the tree flattened to its full path, parsed to each type up front
+    struct Value;
+    struct Snapshot;
+    struct Slot;
+    struct LazyFile;
+    struct BlobStore;
+
     boost::property_tree::ptree m_tree;
     bool m_saveOnWrite;
     std::string m_path;
+    //guards m_tree and the write-behind state
     std::mutex m_mutex;
+    //keeps saves in order so an older snapshot never replaces a newer one
+    std::mutex m_saveMutex;
+
+    std::chrono::milliseconds m_writeBehind{ 0 };
+    bool m_dirty = false;
+    bool m_stopping = false;
+    std::chrono::steady_clock::time_point m_firstDirty;
+    std::chrono::steady_clock::time_point m_lastWrite;
+    std::condition_variable m_flushSignal;
+    std::thread m_flushThread;
+
+    //reads are served from an immutable snapshot of the tree, each thread keeps the one it last
+    //used until m_generation says it's out of date. Writes patch the value they changed into a new
+    //snapshot, or into the current one if no other thread is using it
+    std::uint64_t m_id;
+    std::atomic<std::uint64_t> m_generation{ 0 };
+    std::shared_ptr<Snapshot> m_snapshot;
+    //how many writes are kept beside the shared values before they're folded in
+    static constexpr size_t maxChanged = 64;
+
+    static Slot &ThreadSlot(std::uint64_t id);
+    const Snapshot &CurrentSnapshot();
+    void Patch(const std::string &path);
+    const Value *Find(const char *prefix, const std::string &group_name, const std::string &key);
+
+    //a copy of the file read in by a lazy load and the top level groups in it that haven't been parsed yet
+    std::unique_ptr<LazyFile> m_lazyFile;
+    std::atomic<size_t> m_lazyRemaining{ 0 };
+
+    bool GroupPending(std::string_view group_name) const;
+    void LoadGroup(std::string_view group_name);
+    void LoadAllGroups();
+    bool IndexGroups();
+
+    //opened on first use, has its own lock so big blobs aren't read or written under m_mutex
+    std::unique_ptr<BlobStore> m_blobs;
+    std::mutex m_blobMutex;
+
+    BlobView FindBlob(std::uint64_t hash);
+
+    void Load(bool lazy);
+    void Changed(std::unique_lock<std::mutex> &lock, const std::string &path);
+    void FlushThread();
 };
 
 //hack the settings onto the AfxGetApp call for compatibility
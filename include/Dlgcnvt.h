@@ -26,6 +26,12 @@
 #include "convert.h"
 #include "hssconfig/config.h"
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #ifdef _MSC_VER
 
 #if !defined(__INTEL_COMPILER) && !defined(__INTEL_LLVM_COMPILER)
@@ -38,27 +44,90 @@
 #endif					// to make this class as small as possible
 
 class UnitConversion {
+public:
+	/// <summary>
+	/// The display formats held by a UnitConversion, used to tag the columns passed to ConvertColumns.
+	/// </summary>
+	enum class Category : std::uint8_t
+	{
+		SmallMeasure = 0,
+		SmallDistance,
+		Distance,
+		AltDistance,
+		Area,
+		Volume,
+		Temp,
+		Mass,
+		MassArea,
+		Energy,
+		Angle,
+		Velocity,
+		AltVelocity,
+		Coordinate,
+		Intensity,
+		Power,
+		COUNT
+	};
+
+	/// <summary>
+	/// A column of values to convert from its storage unit to the display format of its category.
+	/// </summary>
+	struct Column
+	{
+		const double* in;
+		double* out;							// may be the same as in
+		UnitConvert::STORAGE_UNIT storage;		// the unit the values in the column are stored in
+		Category category;
+	};
+
+	/// <summary>
+	/// An immutable set of display formats. Each change to a UnitConversion publishes a new Profile, so a
+	/// reader holding one never sees a partially updated compound format. Profiles are kept for the life of
+	/// the UnitConversion, but a change back to a profile that was used before reuses it rather than adding
+	/// another, so only the distinct profiles are ever kept.
+	/// </summary>
+	struct Profile
+	{
+		UnitConvert::STORAGE_UNIT	small_measure_display,
+									small_distance_display,
+									distance_display,
+									alt_distance_display,
+									area_display,
+									volume_display,
+									temp_display,
+									mass_display,
+									energy_display,
+									angle_display,
+									velocity_display,			// the high order byte stores something in the STORAGE_TIME_START-END range, the low order byte is distance
+									alt_velocity_display,		// the high order byte stores something in the STORAGE_TIME_START-END range, the low order byte is distance
+									coordinate_display,
+									intensity_display,			// use the high order word to store the energy, and the low order word to store the distance & time
+									mass_area_display,			// use the high order word to store the mass, and the low order word to store the area
+									power_display;
+		std::string_view			language_display;
+
+		UnitConvert::STORAGE_UNIT Display(Category category) const;
+		bool operator==(const Profile& other) const;
+		bool operator!=(const Profile& other) const { return !(*this == other); }
+	};
+
 protected:
-	UnitConvert::STORAGE_UNIT	m_small_measure_display,
-								m_small_distance_display,
-								m_distance_display,
-								m_alt_distance_display,
-								m_area_display,
-								m_volume_display,
-								m_temp_display,
-								m_mass_display,
-								m_energy_display,
-								m_angle_display,
-								m_velocity_display,			// the high order byte stores something in the STORAGE_TIME_START-END range, the low order byte is distance
-								m_alt_velocity_display,		// the high order byte stores something in the STORAGE_TIME_START-END range, the low order byte is distance
-								m_coordinate_display,
-								m_intensity_display,		// use the high order word to store the energy, and the low order word to store the distance & time
-								m_mass_area_display,		// use the high order word to store the mass, and the low order word to store the area
-								m_power_display;
-	std::string_view			m_language_display;
+	std::atomic<const Profile*>	m_profile;		// the current profile, only ever replaced, never modified
+	mutable std::mutex			m_writeLock;	// serializes writers
+	std::vector<std::unique_ptr<const Profile>> m_profiles;	// every distinct profile published, so snapshots stay valid for the life of this object
+
+	static_assert(std::atomic<const Profile*>::is_always_lock_free, "readers of the current profile must not lock");
+
+	template<typename Func>
+	const Profile& Publish(Func&& update);
+	const Profile* Retain(const Profile& profile);
 
 public:
 	UnitConversion(const TCHAR *group_name);
+	UnitConversion(const UnitConversion& other);
+	~UnitConversion() = default;
+
+	UnitConversion& operator=(const UnitConversion& other);
 	void SaveToIniFile(const TCHAR *group_name) const;
 
 	void ResetToDefaults();
@@ -80,26 +149,49 @@ public:
 	UnitConvert::STORAGE_UNIT IntensityDisplay(UnitConvert::STORAGE_UNIT mode);				// fire intensities
 	UnitConvert::STORAGE_UNIT PowerDisplay(UnitConvert::STORAGE_UNIT mode);					// Power (a subset of the energy units)
 
-	UnitConvert::STORAGE_UNIT SmallMeasureDisplay() const		{ return m_small_measure_display; };
-	UnitConvert::STORAGE_UNIT SmallDistanceDisplay() const		{ return m_small_distance_display; };
-	UnitConvert::STORAGE_UNIT DistanceDisplay() const			{ return m_distance_display; };
-	UnitConvert::STORAGE_UNIT AltDistanceDisplay() const		{ return m_alt_distance_display; };
-	UnitConvert::STORAGE_UNIT AreaDisplay() const				{ return m_area_display; };
-	UnitConvert::STORAGE_UNIT VolumeDisplay() const			{ return m_volume_display; };
-	UnitConvert::STORAGE_UNIT TempDisplay() const				{ return m_temp_display; };
-	UnitConvert::STORAGE_UNIT MassDisplay() const				{ return m_mass_display; };
-	UnitConvert::STORAGE_UNIT MassAreaDisplay() const			{ return m_mass_area_display; };
-	UnitConvert::STORAGE_UNIT EnergyDisplay() const			{ return m_energy_display; };
-	UnitConvert::STORAGE_UNIT AngleDisplay() const				{ return m_angle_display; };
-	UnitConvert::STORAGE_UNIT VelocityDisplay() const			{ return m_velocity_display; };
-	UnitConvert::STORAGE_UNIT AltVelocityDisplay() const		{ return m_alt_velocity_display; };
-	UnitConvert::STORAGE_UNIT CoordinateDisplay() const		{ return m_coordinate_display; };
-	UnitConvert::STORAGE_UNIT IntensityDisplay() const			{ return m_intensity_display; };
-	UnitConvert::STORAGE_UNIT PowerDisplay() const				{ return m_power_display; }
+	UnitConvert::STORAGE_UNIT SmallMeasureDisplay() const		{ return Snapshot().small_measure_display; }
+	UnitConvert::STORAGE_UNIT SmallDistanceDisplay() const		{ return Snapshot().small_distance_display; }
+	UnitConvert::STORAGE_UNIT DistanceDisplay() const			{ return Snapshot().distance_display; }
+	UnitConvert::STORAGE_UNIT AltDistanceDisplay() const		{ return Snapshot().alt_distance_display; }
+	UnitConvert::STORAGE_UNIT AreaDisplay() const				{ return Snapshot().area_display; }
+	UnitConvert::STORAGE_UNIT VolumeDisplay() const			{ return Snapshot().volume_display; }
+	UnitConvert::STORAGE_UNIT TempDisplay() const				{ return Snapshot().temp_display; }
+	UnitConvert::STORAGE_UNIT MassDisplay() const				{ return Snapshot().mass_display; }
+	UnitConvert::STORAGE_UNIT MassAreaDisplay() const			{ return Snapshot().mass_area_display; }
+	UnitConvert::STORAGE_UNIT EnergyDisplay() const			{ return Snapshot().energy_display; }
+	UnitConvert::STORAGE_UNIT AngleDisplay() const				{ return Snapshot().angle_display; }
+	UnitConvert::STORAGE_UNIT VelocityDisplay() const			{ return Snapshot().velocity_display; }
+	UnitConvert::STORAGE_UNIT AltVelocityDisplay() const		{ return Snapshot().alt_velocity_display; }
+	UnitConvert::STORAGE_UNIT CoordinateDisplay() const		{ return Snapshot().coordinate_display; }
+	UnitConvert::STORAGE_UNIT IntensityDisplay() const			{ return Snapshot().intensity_display; }
+	UnitConvert::STORAGE_UNIT PowerDisplay() const				{ return Snapshot().power_display; }
+	UnitConvert::STORAGE_UNIT Display(Category category) const	{ return Snapshot().Display(category); }
+
+	/// <summary>
+	/// The current display formats. Lock free, the returned profile is never modified and remains valid for
+	/// the lifetime of this object, so a caller needing several formats that agree with each other should read
+	/// them all from one snapshot rather than through the individual getters.
+	/// </summary>
+	const Profile& Snapshot() const							{ return *m_profile.load(std::memory_order_acquire); }
 
 	static float ConvertUnit(float value, UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format);	// **** note reversal of parmeter order
 	static double ConvertUnit(double value, UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format);
+	/// <summary>
+	/// Convert count values from from_format to to_format. Conversions that are a plain scale and offset are
+	/// detected once per pair of formats and cached, so the per value cost is a multiply-add. Others (ex. compass
+	/// angles) fall back to converting each value. in and out may be the same array.
+	/// </summary>
+	static void ConvertUnit(const double* in, double* out, std::size_t count, UnitConvert::STORAGE_UNIT from_format, UnitConvert::STORAGE_UNIT to_format);
+	/// <summary>
+	/// Convert a table of columns, each to the current display format of its category. Large tables are converted
+	/// on multiple threads, one column at a time per thread.
+	/// </summary>
+	/// <param name="columns">The columns to convert.</param>
+	/// <param name="column_count">The number of entries in columns.</param>
+	/// <param name="row_count">The number of values in each column.</param>
+	void ConvertColumns(const Column* columns, std::size_t column_count, std::size_t row_count) const;
 	static std::string UnitName(UnitConvert::STORAGE_UNIT format, bool short_format);
+	static std::string_view UnitNameView(UnitConvert::STORAGE_UNIT format, bool short_format) { return UnitConvert::UnitNameView(format, short_format); }
 
 #if _DLL
 	static CString CUnitName(UnitConvert::STORAGE_UNIT format, bool short_format)											{ return CString(UnitConvert::UnitName(format, short_format).c_str()); }
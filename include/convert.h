@@ -27,6 +27,13 @@
 
 #include "types.h"
 #include "tstring.h"
+#include <string_view>
+#include <cstddef>
+#if __has_include(<mathimf.h>)
+#include <mathimf.h>
+#else
+#include <cmath>
+#endif
 
 namespace UnitConvert {
 
@@ -181,15 +188,118 @@ constexpr UnitConvert::STORAGE_UNITCONVERT STORAGE_FORMAT_MEGAWATT_HOUR = ((Unit
 	#define STORAGE_COORDINATE_RELATIVE_DISTANCE	((UnitConvert::STORAGE_UNITCONVERT)0x00000804)
 #define STORAGE_COORDINATE_END				((UnitConvert::STORAGE_UNITCONVERT)0x00000804)
 
+/// <summary>
+/// Reasons that a value-with-unit string could not be converted.
+/// </summary>
+enum class ConvertError : std::uint8_t
+{
+	NONE = 0,
+	NO_VALUE,			// the string was empty or only contained whitespace
+	INVALID_VALUE,		// the leading number could not be parsed
+	UNKNOWN_UNIT		// no from_format was given and the trailing unit wasn't recognized
+};
+
+/// <summary>
+/// The result of parsing (and optionally converting) a value-with-unit string such as "-1.5e3 m".
+/// </summary>
+struct ConvertResult
+{
+	/// <summary>
+	/// The parsed (or converted) value, 0 on error.
+	/// </summary>
+	double value;
+	/// <summary>
+	/// The unit the value was parsed in, either the from_format that was passed or the one detected from the string.
+	/// </summary>
+	STORAGE_UNIT from_format;
+	ConvertError error;
+
+	constexpr bool ok() const noexcept { return error == ConvertError::NONE; }
+	constexpr explicit operator bool() const noexcept { return ok(); }
+};
+
 float convertUnit(float value, STORAGE_UNIT to_format, STORAGE_UNIT from_format);
 double convertUnit(double value, STORAGE_UNIT to_format, STORAGE_UNIT from_format);
 double convertUnit(tstring value, STORAGE_UNIT to_format, STORAGE_UNIT from_format, int* ierr = nullptr);
 double convertUnit(tstring value, STORAGE_UNIT to_format, int* ierr = nullptr);
+/// <summary>
+/// Parse a value-with-unit string without allocating. The number may be signed and use scientific notation,
+/// whitespace is allowed around the number and unit.
+/// </summary>
+/// <param name="value">The string to parse.</param>
+/// <param name="from_format">The unit the value is in. If 0 the unit is detected from the text following the number.</param>
+ConvertResult parseUnit(std::string_view value, STORAGE_UNIT from_format = 0);
+/// <summary>
+/// Parse a value-with-unit string and convert it to to_format. Doesn't allocate unless the unit name needs
+/// one of the fuzzy (plural, bracketed) lookups.
+/// </summary>
+/// <param name="value">The string to parse.</param>
+/// <param name="to_format">The unit to convert the value to.</param>
+/// <param name="from_format">The unit the value is in. If 0 the unit is detected from the text following the number.</param>
+ConvertResult tryConvertUnit(std::string_view value, STORAGE_UNIT to_format, STORAGE_UNIT from_format = 0);
 tstring UnitName(STORAGE_UNIT format, bool short_format);
+/// <summary>
+/// The same name UnitName returns but interned in a process wide table, so only the first request for
+/// a format (including compound formats) builds the string and later calls are a lookup only. Thread safe.
+/// </summary>
+/// <returns>A view that remains valid for the lifetime of the process.</returns>
+std::string_view UnitNameView(STORAGE_UNIT format, bool short_format);
 STORAGE_UNIT UnitFormat(STORAGE_UNIT UnitType, const TCHAR *UnitName);
 STORAGE_UNITCONVERT UnitFormat(STORAGE_UNITCONVERT UnitType, const TCHAR* UnitName);
 STORAGE_UNITCONVERT UnitFormatSearch(STORAGE_UNITCONVERT UnitType, const TCHAR* UnitName, std::uint32_t trial = 0);
 
+constexpr double ANGLE_PI = 3.14159265358979323846264;
+constexpr double ANGLE_TWO_PI = 6.28318530717958647692529;
+constexpr double ANGLE_ONE_OVER_TWO_PI = 0.159154943091895335768884;
+constexpr double ANGLE_TWO_HALF_PI = 7.85398163397448309615661;
+constexpr double ANGLE_DEGREE_TO_RADIAN = ANGLE_PI / 180.0;
+constexpr double ANGLE_RADIAN_TO_DEGREE = 180.0 / ANGLE_PI;
+
+inline double degreeToRadian(double x) noexcept { return x * ANGLE_DEGREE_TO_RADIAN; }
+inline double radianToDegree(double x) noexcept { return x * ANGLE_RADIAN_TO_DEGREE; }
+
+/// <summary>
+/// ANGLE_TWO_PI split in two for the range reduction in normalizeAngleRadian. HI keeps only the top 33 bits so
+/// n * HI is exact for |n| < 2^20, and LO (the remaining 15 bits) makes n * LO exact as well, so reducing by
+/// both matches fmod(x, ANGLE_TWO_PI) to within a rounding.
+/// </summary>
+constexpr double ANGLE_TWO_PI_HI = 0x1.921fb544p+2;
+constexpr double ANGLE_TWO_PI_LO = 0x1.0b46p-32;
+constexpr double ANGLE_REDUCE_LIMIT = 1048576.0;
+
+/// <summary>
+/// Normalize an angle to [0, 2PI]. Uses a truncation based range reduction rather than fmod, only falling
+/// back to fmod for angles of more than 2^20 turns (or NaN/infinity).
+/// </summary>
+inline double normalizeAngleRadian(double x) noexcept
+{
+	const double q = x * ANGLE_ONE_OVER_TWO_PI;
+	if (!(fabs(q) < ANGLE_REDUCE_LIMIT))
+	{
+		const double r = fmod(x, ANGLE_TWO_PI);
+		return (r < 0.0) ? (r + ANGLE_TWO_PI) : r;
+	}
+	const double n = (double)(std::int32_t)q;
+	double r = (x - n * ANGLE_TWO_PI_HI) - n * ANGLE_TWO_PI_LO;
+	// q is rounded so the truncation can be off by one turn either way
+	r += (r < 0.0) ? ANGLE_TWO_PI : 0.0;
+	r -= (r >= ANGLE_TWO_PI) ? ANGLE_TWO_PI : 0.0;
+	return r;
+}
+
+inline double cartesianToCompassRadian(double x) noexcept { return normalizeAngleRadian(ANGLE_TWO_HALF_PI - x); }
+inline double compassToCartesianRadian(double x) noexcept { return normalizeAngleRadian(ANGLE_TWO_HALF_PI - x); }
+
+/// <summary>
+/// Array versions of the angle helpers above, vectorized where the platform supports it. in and out may
+/// be the same array.
+/// </summary>
+void degreeToRadian(const double* in, double* out, std::size_t count) noexcept;
+void radianToDegree(const double* in, double* out, std::size_t count) noexcept;
+void normalizeAngleRadian(const double* in, double* out, std::size_t count) noexcept;
+void cartesianToCompassRadian(const double* in, double* out, std::size_t count) noexcept;
+void compassToCartesianRadian(const double* in, double* out, std::size_t count) noexcept;
+
 HSS_PRAGMA_WARNING_PUSH
 HSS_PRAGMA_GCC(GCC diagnostic ignored "-Wunused-variable")
 HSS_PRAGMA_CLANG(clang diagnostic ignored "-Wunused-variable")
@@ -0,0 +1,105 @@
+/**
+ * numeric_column.h
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "propsysreplacement.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(push, off)
+#endif
+#endif //_MSC_VER
+
+
+/// <summary>
+/// A column of NumericVariant values, ex. one attribute of a grid. While every value holds the same alternative they
+/// are stored packed as that type, 1 to 8 bytes per value instead of the 16 of a NumericVariant, and can be converted
+/// in bulk with SSE2. Adding a value of another type moves the column to a tagged layout of a type byte and 8 bytes of
+/// payload per value.
+/// </summary>
+class NumericColumn
+{
+public:
+	/// <summary>
+	/// The type() of a column that holds more than one alternative.
+	/// </summary>
+	static constexpr std::size_t mixed = std::variant_npos;
+
+	NumericColumn() = default;
+	NumericColumn(const NumericVariant* values, std::size_t count);
+	explicit NumericColumn(const std::vector<NumericVariant>& values) : NumericColumn(values.data(), values.size()) { }
+
+	std::size_t size() const noexcept { return m_size; }
+	bool empty() const noexcept { return m_size == 0; }
+	/// <summary>
+	/// The index in NumericVariant of the alternative every value holds, or mixed. 0 (std::monostate) for an empty column.
+	/// </summary>
+	std::size_t type() const noexcept { return m_type; }
+	/// <summary>
+	/// The number of bytes allocated for the values.
+	/// </summary>
+	std::size_t memoryUsage() const noexcept { return m_bytes.capacity() + m_tags.capacity(); }
+
+	void reserve(std::size_t count);
+	void clear() noexcept;
+	void push_back(const NumericVariant& value);
+	NumericVariant operator[](std::size_t index) const noexcept;
+
+	/// <summary>
+	/// Convert count values starting at first with the same rules as variantTo. Values that can't be converted are
+	/// set to 0.
+	/// </summary>
+	/// <returns>False if any of the values couldn't be converted, or the range is outside the column.</returns>
+	bool toDouble(double* out, std::size_t first, std::size_t count) const noexcept;
+	bool toFloat(float* out, std::size_t first, std::size_t count) const noexcept;
+	bool toInt32(std::int32_t* out, std::size_t first, std::size_t count) const noexcept;
+	bool toInt64(std::int64_t* out, std::size_t first, std::size_t count) const noexcept;
+
+	bool toDouble(double* out) const noexcept { return toDouble(out, 0, m_size); }
+	bool toFloat(float* out) const noexcept { return toFloat(out, 0, m_size); }
+	bool toInt32(std::int32_t* out) const noexcept { return toInt32(out, 0, m_size); }
+	bool toInt64(std::int64_t* out) const noexcept { return toInt64(out, 0, m_size); }
+
+private:
+	std::size_t m_size = 0;
+	std::size_t m_type = 0;
+	/// <summary>
+	/// The packed values when they're all of m_type, otherwise 8 bytes per value.
+	/// </summary>
+	std::vector<std::uint8_t> m_bytes;
+	/// <summary>
+	/// The alternative of each value in the tagged layout.
+	/// </summary>
+	std::vector<std::uint8_t> m_tags;
+
+	void makeTagged();
+	template<typename T>
+	bool convert(T* out, std::size_t first, std::size_t count) const noexcept;
+};
+
+#ifdef _MSC_VER
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(pop)
+#endif
+#endif
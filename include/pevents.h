@@ -16,6 +16,11 @@
 #endif
 
 #include <stdint.h>
+#include <chrono>
+#if defined(PEVENTS_INSTRUMENTATION) && !defined(_WIN32)
+#include <cstdio>
+#include <string>
+#endif
 
 namespace neosmart
 {
@@ -23,19 +28,83 @@ namespace neosmart
 	struct neosmart_event_t_;
 	typedef neosmart_event_t_ * neosmart_event_t;
 
+	//Options for creating an event. With a spin and/or yield budget a wait that finds the event unsignaled
+	//first spins SpinCount times with a pause instruction, then yields the processor up to YieldCount times,
+	//before blocking in the kernel. That suits short producer/consumer handoffs where the wake up latency of a
+	//blocked thread dominates. There is no spinning on a single processor machine. Ignored on Windows.
+	struct neosmart_event_attr_t
+	{
+		bool ManualReset = false;
+		bool InitialState = false;
+		uint32_t SpinCount = 0;
+		uint32_t YieldCount = 0;
+		//Identifies the event in the instrumentation, copied
+		const char *Name = nullptr;
+	};
+
+	//How the waits on an event that didn't find it signaled were satisfied, for tuning the spin and yield budgets
+	struct neosmart_event_stats_t
+	{
+		uint64_t Spins = 0;		//acquired while spinning
+		uint64_t Yields = 0;	//acquired while yielding
+		uint64_t Blocks = 0;	//went on to block in the kernel
+	};
+
     // Function declarations
 	neosmart_event_t CreateEvent(bool manualReset = false, bool initialState = false);
+	neosmart_event_t CreateEvent(bool manualReset, bool initialState, const char *name);
+	neosmart_event_t CreateEvent(const neosmart_event_attr_t &attributes);
 	int DestroyEvent(neosmart_event_t event);
     int WaitForEvent(neosmart_event_t event, uint64_t milliseconds = -1ul);
+	//Timed wait with sub-millisecond resolution, std::chrono::nanoseconds::max() waits forever
+	int WaitForEvent(neosmart_event_t event, std::chrono::nanoseconds timeout);
 	int SetEvent(neosmart_event_t event);
 	int ResetEvent(neosmart_event_t event);
+	int GetEventWaitStats(neosmart_event_t event, neosmart_event_stats_t &stats);
+#if defined(__linux__)
+	//An eventfd that polls readable (POLLIN) while the event is signaled, for waiting on events together with
+	//sockets and files in one epoll/poll loop. Created on first use and owned by the event, so don't close it or
+	//read from it. It only reports the state: once it polls readable, take an auto-reset event with
+	//WaitForEvent(event, 0), which may time out if another thread got there first. Returns -1 with errno set
+	//if the descriptor can't be created.
+	int GetEventPollFd(neosmart_event_t event);
+#endif
 #ifdef WFMO
     int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
                               uint64_t milliseconds);
     int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
                               uint64_t milliseconds, int &index);
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+	                          std::chrono::nanoseconds timeout);
+	int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+	                          std::chrono::nanoseconds timeout, int &index);
 #endif
 #ifdef PULSE
 	int PulseEvent(neosmart_event_t event);
 #endif
+#if defined(PEVENTS_INSTRUMENTATION) && !defined(_WIN32)
+	//Build with PEVENTS_INSTRUMENTATION to keep counters and wait times for every event and a registry of the
+	//live events, for finding out what a stalled pipeline is blocked on. POSIX only.
+	static const int EventWaitHistogramBuckets = 32;
+
+	struct neosmart_event_info_t
+	{
+		std::string Name;
+		bool ManualReset;
+		bool Signaled;
+		uint64_t Sets;
+		uint64_t Waits;					//calls to WaitForEvent that have returned
+		uint64_t Timeouts;
+		uint32_t Waiters;				//threads in WaitForEvent right now
+		uint32_t PeakWaiters;
+		uint64_t TotalWaitNanoseconds;
+		uint64_t MaxWaitNanoseconds;
+		//Bucket 0 counts waits under a microsecond, bucket i those from 2^(i-1) up to 2^i microseconds
+		uint64_t WaitHistogram[EventWaitHistogramBuckets];
+	};
+
+	int GetEventInfo(neosmart_event_t event, neosmart_event_info_t &info);
+	//Write a line per live event, with its wait time histogram, to out
+	void DumpEvents(FILE *out);
+#endif
 } // namespace neosmart
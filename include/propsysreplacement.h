@@ -46,11 +46,72 @@ HRESULT VariantToDouble_(const VARIANT &varIn, DOUBLE *pdblRet);
 
 #if __cplusplus>=201700 || _MSVC_LANG >= 201703
 #include <cstdint>
+#include <type_traits>
 #include <variant>
+#include "types.h"
 
 typedef std::variant<std::monostate, bool, std::int8_t, std::int16_t, std::int32_t, std::int64_t, std::uint8_t, std::uint16_t, std::uint32_t, std::uint64_t, float, double> NumericVariant;
 
 
+namespace detail {
+	template<typename T, typename V>
+	bool convertNumeric(V value, T *retval) {
+		if constexpr (std::is_same_v<T, bool>) {
+			if constexpr (std::is_floating_point_v<V>)
+				return false;
+			else
+				*retval = (value) ? true : false;
+		}
+		else if constexpr (std::is_floating_point_v<T>) {
+			if constexpr (std::is_same_v<V, bool>)
+				return false;
+			else
+				*retval = (T)value;
+		}
+		else if constexpr (std::is_same_v<V, bool>)
+			*retval = (value) ? 1 : 0;
+		else if constexpr (std::is_floating_point_v<V>)
+			*retval = (T)(value + 0.5);
+		else
+			*retval = (T)value;
+		return true;
+	}
+}
+
+
+// Convert whatever the variant holds to T with a single jump on the variant's index. Empty
+// variants can't be converted, and neither can floating point values to bool or bool to floating
+// point. Floating point values are rounded by adding 0.5 before they're truncated to integers.
+template<typename T>
+bool variantTo(const NumericVariant &varIn, T *retval) {
+
+	static_assert(std::is_arithmetic_v<T>, "variantTo converts to the numeric types a NumericVariant can hold");
+	static_assert(std::variant_size_v<NumericVariant> == 12, "a case is needed for every alternative");
+
+	bool converted;
+	switch (varIn.index()) {
+	case 1:		converted = detail::convertNumeric(*std::get_if<1>(&varIn), retval);	break;
+	case 2:		converted = detail::convertNumeric(*std::get_if<2>(&varIn), retval);	break;
+	case 3:		converted = detail::convertNumeric(*std::get_if<3>(&varIn), retval);	break;
+	case 4:		converted = detail::convertNumeric(*std::get_if<4>(&varIn), retval);	break;
+	case 5:		converted = detail::convertNumeric(*std::get_if<5>(&varIn), retval);	break;
+	case 6:		converted = detail::convertNumeric(*std::get_if<6>(&varIn), retval);	break;
+	case 7:		converted = detail::convertNumeric(*std::get_if<7>(&varIn), retval);	break;
+	case 8:		converted = detail::convertNumeric(*std::get_if<8>(&varIn), retval);	break;
+	case 9:		converted = detail::convertNumeric(*std::get_if<9>(&varIn), retval);	break;
+	case 10:	converted = detail::convertNumeric(*std::get_if<10>(&varIn), retval);	break;
+	case 11:	converted = detail::convertNumeric(*std::get_if<11>(&varIn), retval);	break;
+	default:	converted = false;							break;
+	}
+
+	if (!converted) {
+		weak_assert(false);
+		*retval = 0;
+	}
+	return converted;
+}
+
+
 bool variantToBoolean(const NumericVariant &varIn, bool *retval);
 bool variantToInt8(const NumericVariant &varIn, std::int8_t *retval);
 bool variantToInt16(const NumericVariant &varIn, std::int16_t *retval);
@@ -0,0 +1,269 @@
+/**
+ * thread_pool.h
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "WinReplacement.h"
+#include "pevents.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef _MSC_VER
+
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(push, off)
+#endif
+#endif //_MSC_VER
+
+
+namespace hss
+{
+	namespace detail
+	{
+		/// <summary>
+		/// The completion state shared by a queued task and its futures. Completion is a manual-reset neosmart event.
+		/// </summary>
+		class task_state
+		{
+		public:
+			task_state() : m_event(neosmart::CreateEvent(true, false)) { }
+			task_state(const task_state&) = delete;
+			task_state& operator=(const task_state&) = delete;
+			~task_state() { neosmart::DestroyEvent(m_event); }
+
+			neosmart::neosmart_event_t event() const noexcept { return m_event; }
+			bool ready() const { return neosmart::WaitForEvent(m_event, 0) == 0; }
+			void wait() const { neosmart::WaitForEvent(m_event); }
+			bool wait_for(std::chrono::nanoseconds timeout) const { return neosmart::WaitForEvent(m_event, timeout) == 0; }
+			void complete() { neosmart::SetEvent(m_event); }
+
+			std::exception_ptr m_exception;
+
+		private:
+			neosmart::neosmart_event_t m_event;
+		};
+
+		template<typename T>
+		class task_result : public task_state
+		{
+		public:
+			std::optional<T> m_value;
+		};
+
+		template<>
+		class task_result<void> : public task_state
+		{
+		};
+
+		/// <summary>
+		/// A queued unit of work.
+		/// </summary>
+		class task_base
+		{
+		public:
+			virtual ~task_base() = default;
+			virtual void run() = 0;
+		};
+
+		template<typename Func, typename T>
+		class task final : public task_base
+		{
+		public:
+			task(Func&& func, std::shared_ptr<task_result<T>> result) : m_func(std::move(func)), m_result(std::move(result)) { }
+
+			void run() override
+			{
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+						m_func();
+					else
+						m_result->m_value.emplace(m_func());
+				}
+				catch (...)
+				{
+					m_result->m_exception = std::current_exception();
+				}
+				m_result->complete();
+			}
+
+		private:
+			Func m_func;
+			std::shared_ptr<task_result<T>> m_result;
+		};
+	}
+
+	/// <summary>
+	/// The result of a task submitted to a thread_pool. Copies share the same result.
+	/// </summary>
+	template<typename T>
+	class task_future
+	{
+	public:
+		task_future() = default;
+		explicit task_future(std::shared_ptr<detail::task_result<T>> result) noexcept : m_result(std::move(result)) { }
+
+		bool valid() const noexcept { return (bool)m_result; }
+		/// <summary>
+		/// Whether the task has finished, without blocking.
+		/// </summary>
+		bool ready() const { return m_result->ready(); }
+		void wait() const { m_result->wait(); }
+		/// <summary>
+		/// Wait for the task to finish.
+		/// </summary>
+		/// <returns>False if the timeout expired first.</returns>
+		bool wait_for(std::chrono::nanoseconds timeout) const { return m_result->wait_for(timeout); }
+		/// <summary>
+		/// A manual-reset event that is signaled when the task finishes, so a future can be waited on together
+		/// with other events (WaitForMultipleEvents, or GetEventPollFd on Linux). Owned by the future, don't
+		/// destroy or reset it.
+		/// </summary>
+		neosmart::neosmart_event_t event() const noexcept { return m_result->event(); }
+
+		/// <summary>
+		/// Wait for the task and return its result, rethrowing anything the task threw.
+		/// </summary>
+		T get() const
+		{
+			m_result->wait();
+			if (m_result->m_exception)
+				std::rethrow_exception(m_result->m_exception);
+			if constexpr (!std::is_void_v<T>)
+				return *m_result->m_value;
+		}
+
+	private:
+		std::shared_ptr<detail::task_result<T>> m_result;
+	};
+
+	struct thread_pool_options
+	{
+		/// <summary>
+		/// The number of worker threads, 0 for one per available processor.
+		/// </summary>
+		size_t thread_count = 0;
+		/// <summary>
+		/// Pin each worker to a single processor.
+		/// </summary>
+		bool pin_threads = false;
+		/// <summary>
+		/// Spread the workers evenly over the NUMA nodes, keep each one on its node's processors and have it steal
+		/// work from its own node first. Linux only.
+		/// </summary>
+		bool numa_aware = true;
+	};
+
+	/// <summary>
+	/// A work-stealing thread pool. Each worker has a queue per priority, the THREAD_PRIORITY_* levels from
+	/// LOWEST to HIGHEST, and runs its own highest priority task first. Tasks submitted from a worker go to that
+	/// worker's own queues and run newest first, tasks from other threads are spread over the workers. A worker
+	/// with an empty queue steals the oldest, highest priority task from the others, starting with the workers on
+	/// its NUMA node, and sleeps on a neosmart event when there is nothing to steal.
+	/// </summary>
+	class thread_pool
+	{
+	public:
+		static constexpr size_t priority_count = 5;
+
+		explicit thread_pool(const thread_pool_options& options = thread_pool_options());
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+		/// <summary>
+		/// Runs every task that is still queued before the workers exit.
+		/// </summary>
+		~thread_pool();
+
+		size_t thread_count() const noexcept { return m_workers.size(); }
+		/// <summary>
+		/// The number of NUMA nodes the workers were spread over, 1 if the machine isn't NUMA or the pool isn't
+		/// NUMA aware.
+		/// </summary>
+		size_t node_count() const noexcept { return m_nodeCount; }
+		/// <summary>
+		/// The index of the calling worker thread in this pool, or -1 if it isn't one of the pool's workers.
+		/// </summary>
+		int current_worker() const noexcept;
+
+		/// <summary>
+		/// Queue a function to run on the pool.
+		/// </summary>
+		/// <param name="priority">One of the THREAD_PRIORITY_* values, anything else is treated as THREAD_PRIORITY_NORMAL.</param>
+		template<typename Func>
+		auto submit(Func&& func, int priority = THREAD_PRIORITY_NORMAL) -> task_future<std::invoke_result_t<std::decay_t<Func>&>>
+		{
+			using result_type = std::invoke_result_t<std::decay_t<Func>&>;
+			auto result = std::make_shared<detail::task_result<result_type>>();
+			enqueue(std::make_unique<detail::task<std::decay_t<Func>, result_type>>(std::decay_t<Func>(std::forward<Func>(func)), result), priority);
+			return task_future<result_type>(std::move(result));
+		}
+
+	private:
+		using task_ptr = std::unique_ptr<detail::task_base>;
+
+		struct worker
+		{
+			std::mutex lock;
+			std::deque<task_ptr> queues[priority_count];
+			neosmart::neosmart_event_t wake;
+			std::thread thread;
+			size_t node = 0;
+			/// <summary>
+			/// The processors the worker is restricted to, empty to leave it to the OS.
+			/// </summary>
+			std::vector<int> affinity;
+		};
+
+		std::vector<std::unique_ptr<worker>> m_workers;
+		/// <summary>
+		/// For each worker, the other workers in the order it tries to steal from them.
+		/// </summary>
+		std::vector<std::vector<size_t>> m_stealOrder;
+		size_t m_nodeCount = 1;
+		std::atomic<size_t> m_queued{ 0 };
+		std::atomic<size_t> m_nextWorker{ 0 };
+		std::atomic<bool> m_stopping{ false };
+		std::atomic<size_t> m_idleCount{ 0 };
+		std::mutex m_idleLock;
+		std::vector<size_t> m_idle;
+
+		static size_t priority_index(int priority) noexcept;
+
+		void enqueue(task_ptr&& task, int priority);
+		task_ptr pop(size_t index);
+		task_ptr steal(size_t index);
+		void run(size_t index);
+		void wake_idle(size_t preferred);
+	};
+}
+
+#ifdef _MSC_VER
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(pop)
+#endif
+#endif
@@ -0,0 +1,252 @@
+/**
+ * validation_binary.h
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "validation_object.h"
+#include "validation_tree.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#ifdef _MSC_VER
+
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(push, off)
+#endif
+#endif //_MSC_VER
+
+
+/*
+ * Binary format, all integers are unsigned LEB128 varints unless noted:
+ *
+ *   "HVB1"
+ *   string count, then for each string: length, bytes
+ *   node count
+ *   nodes in preorder, each:
+ *     protobuf object string id, error level (1 byte), error identifier string id
+ *     name count, name string ids
+ *     value count, value string ids
+ *     flags (1 byte, 1 = minimum, 2 = maximum, 4 = units, 8 = error message)
+ *     [minimum], [maximum]: inclusive (1 byte), tag (1 byte, 0 = int32, 1 = double, 2 = string),
+ *                           zigzag varint | 8 byte little endian IEEE double | string id
+ *     [units string id], [error message string id]
+ *     child count
+ */
+
+namespace validation
+{
+	/// <summary>
+	/// Encode a validation tree in the compact binary format. Every distinct string is written once.
+	/// </summary>
+	std::vector<std::uint8_t> serialize_binary(const validation_object& root);
+	/// <summary>
+	/// Encode a validation tree in the compact binary format. Every distinct string is written once.
+	/// </summary>
+	std::vector<std::uint8_t> serialize_binary(const validation_tree& tree);
+
+	/// <summary>
+	/// A range value that refers to the encoded data instead of owning a string.
+	/// </summary>
+	using range_value_view = std::variant<std::int32_t, double, std::string_view>;
+
+	struct range_type_view
+	{
+		bool is_inclusive;
+		range_value_view value;
+	};
+
+	/// <summary>
+	/// Read access to binary encoded validation results without decoding them into a tree. Strings are returned
+	/// as views into the encoded data, which must outlive the view. Opening the data makes one pass over it to
+	/// check it and index the nodes, after which every accessor is a direct read.
+	/// </summary>
+	class binary_view
+	{
+	private:
+		static constexpr std::uint32_t none = UINT32_MAX;
+
+		struct entry_type
+		{
+			std::uint32_t end;					// the index after this node's branch, which is its next sibling
+			std::uint32_t child_count;
+			std::uint32_t protobuf_object;
+			std::uint32_t error_identifier;
+			std::uint32_t names;				// offset of the first name id
+			std::uint32_t name_count;
+			std::uint32_t values;				// offset of the first value id
+			std::uint32_t value_count;
+			std::uint32_t minimum;				// offset of the encoded range, or none
+			std::uint32_t maximum;
+			std::uint32_t units;				// string id, or none
+			std::uint32_t error_message;
+			error_level level;
+		};
+
+	public:
+		class node;
+
+		/// <summary>
+		/// A list of strings stored as ids in the encoded data.
+		/// </summary>
+		class string_list
+		{
+		public:
+			class iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string_view*;
+				using reference = std::string_view;
+
+				iterator(const binary_view* view, const std::uint8_t* pos, size_t remaining) noexcept : m_view(view), m_pos(pos), m_remaining(remaining) { }
+
+				std::string_view operator*() const noexcept;
+				iterator& operator++() noexcept;
+				iterator operator++(int) noexcept { iterator i(*this); ++(*this); return i; }
+				bool operator==(const iterator& other) const noexcept { return m_remaining == other.m_remaining; }
+				bool operator!=(const iterator& other) const noexcept { return m_remaining != other.m_remaining; }
+
+			private:
+				const binary_view* m_view;
+				const std::uint8_t* m_pos;
+				size_t m_remaining;
+			};
+
+			string_list(const binary_view* view, const std::uint8_t* first, size_t count) noexcept : m_view(view), m_first(first), m_count(count) { }
+
+			iterator begin() const noexcept { return iterator(m_view, m_first, m_count); }
+			iterator end() const noexcept { return iterator(m_view, nullptr, 0); }
+			size_t size() const noexcept { return m_count; }
+			bool empty() const noexcept { return m_count == 0; }
+			std::string_view front() const noexcept { return *begin(); }
+			std::string_view operator[](size_t index) const noexcept;
+
+		private:
+			const binary_view* m_view;
+			const std::uint8_t* m_first;
+			size_t m_count;
+		};
+
+		/// <summary>
+		/// The children of a node.
+		/// </summary>
+		class child_range
+		{
+		public:
+			class iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = node;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const node*;
+				using reference = node;
+
+				iterator(const binary_view* view, std::uint32_t index) noexcept : m_view(view), m_index(index) { }
+
+				node operator*() const noexcept { return node(m_view, m_index); }
+				iterator& operator++() noexcept { m_index = m_view->m_entries[m_index].end; return *this; }
+				iterator operator++(int) noexcept { iterator i(*this); ++(*this); return i; }
+				bool operator==(const iterator& other) const noexcept { return m_index == other.m_index; }
+				bool operator!=(const iterator& other) const noexcept { return m_index != other.m_index; }
+
+			private:
+				const binary_view* m_view;
+				std::uint32_t m_index;
+			};
+
+			child_range(const binary_view* view, std::uint32_t first, std::uint32_t end, std::uint32_t count) noexcept : m_view(view), m_first(first), m_end(end), m_count(count) { }
+
+			iterator begin() const noexcept { return iterator(m_view, m_first); }
+			iterator end() const noexcept { return iterator(m_view, m_end); }
+			size_t size() const noexcept { return m_count; }
+			bool empty() const noexcept { return m_count == 0; }
+
+		private:
+			const binary_view* m_view;
+			std::uint32_t m_first, m_end, m_count;
+		};
+
+		/// <summary>
+		/// One node of the encoded tree, with the same accessors as validation_object.
+		/// </summary>
+		class node
+		{
+		public:
+			node(const binary_view* view, std::uint32_t index) noexcept : m_view(view), m_index(index) { }
+
+			const node* operator->() const noexcept { return this; }
+
+			std::uint32_t index() const noexcept { return m_index; }
+			/// <summary>
+			/// The maximum error level of this node and its children. Scans the branch.
+			/// </summary>
+			error_level max_error_level() const noexcept;
+			size_t child_count() const noexcept { return entry().child_count; }
+			error_level errorLevel() const noexcept { return entry().level; }
+			std::string_view errorIdentifier() const noexcept { return m_view->m_strings[entry().error_identifier]; }
+			std::string_view protobufObject() const noexcept { return m_view->m_strings[entry().protobuf_object]; }
+			string_list objectName() const noexcept { return string_list(m_view, m_view->m_data + entry().names, entry().name_count); }
+			string_list errorValue() const noexcept { return string_list(m_view, m_view->m_data + entry().values, entry().value_count); }
+			std::optional<range_type_view> minimum() const noexcept { return m_view->range(entry().minimum); }
+			std::optional<range_type_view> maximum() const noexcept { return m_view->range(entry().maximum); }
+			std::optional<std::string_view> units() const noexcept { return m_view->optional_string(entry().units); }
+			std::optional<std::string_view> errorMessage() const noexcept { return m_view->optional_string(entry().error_message); }
+			child_range children() const noexcept { return child_range(m_view, m_index + 1, entry().end, entry().child_count); }
+			node operator[](std::uint32_t index) const noexcept;
+
+		private:
+			const binary_view* m_view;
+			std::uint32_t m_index;
+
+			const entry_type& entry() const noexcept { return m_view->m_entries[m_index]; }
+		};
+
+	public:
+		/// <summary>
+		/// Check and index encoded validation results.
+		/// </summary>
+		/// <param name="data">The encoded data, must remain valid while the view is used.</param>
+		/// <param name="size">The size of data in bytes.</param>
+		/// <exception cref="std::invalid_argument">If the data isn't valid.</exception>
+		binary_view(const std::uint8_t* data, size_t size);
+		explicit binary_view(const std::vector<std::uint8_t>& data) : binary_view(data.data(), data.size()) { }
+
+		size_t size() const noexcept { return m_entries.size(); }
+		node root() const noexcept { return node(this, 0); }
+		error_level max_error_level() const noexcept { return root().max_error_level(); }
+
+	private:
+		const std::uint8_t* m_data;
+		std::vector<std::string_view> m_strings;
+		std::vector<entry_type> m_entries;
+
+		std::optional<range_type_view> range(std::uint32_t offset) const noexcept;
+		std::optional<std::string_view> optional_string(std::uint32_t id) const noexcept;
+	};
+}
+
+#ifdef _MSC_VER
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(pop)
+#endif
+#endif
@@ -22,12 +22,14 @@
 #include "hssconfig/config.h"
 
 #include <string>
+#include <string_view>
 #include <list>
 #include <stdexcept>
 #include <typeinfo>
 #include <variant>
 #include <optional>
 #include <memory>
+#include <vector>
 
 #ifdef __GNUC__
 #include <iostream>
@@ -102,29 +104,45 @@ namespace validation
 	};
 
 	/// <summary>
-	/// Results of a validation check on an object.
+	/// Get the process wide copy of a string. Used for the protobuf type names and error identifiers of validation
+	/// nodes, which come from a small set of constants, so each node holds a pointer instead of its own copy. Thread safe.
+	/// </summary>
+	/// <param name="str">The string to intern.</param>
+	/// <returns>A string equal to str that remains valid for the lifetime of the process.</returns>
+	const std::string& intern_string(std::string_view str);
+
+	class validation_sink;
+
+	/// <summary>
+	/// Results of a validation check on an object. A tree has a single writer: adding children or errors to any
+	/// node updates the counts of all of its ancestors without a lock, so threads that validate in parallel should
+	/// each build their own branch (see concurrent_collector) and add it to the tree from one thread.
 	/// </summary>
 	class validation_object
 	{
-	private:
-		static error_level recursive_max_error_level(const std::list<std::shared_ptr<validation::validation_object>>& list) noexcept;
-
 	public:
 		/// <summary>
-		/// The maximum error level of this node and its children.
+		/// The maximum error level of this node and its children. Maintained as nodes are added so doesn't
+		/// walk the branch.
 		/// </summary>
 		/// <returns>The maximum error level of this branch.</returns>
 		error_level max_error_level() const noexcept;
+		/// <summary>
+		/// The number of nodes in this branch, including this node, that have the given error level.
+		/// Maintained as nodes are added so doesn't walk the branch.
+		/// </summary>
+		/// <param name="level">The error level to count.</param>
+		size_t error_count(error_level level) const noexcept { return m_levelCounts[static_cast<size_t>(level)]; }
 
 	public:
 		validation_object(const std::string& protobufObject, const std::string& name);
 		validation_object(const std::string& protobufObject, std::initializer_list<std::string>&& names);
 		validation_object(const validation_object&) = delete;
-		validation_object(validation_object&&) = default;
+		validation_object(validation_object&& other) noexcept;
 		virtual ~validation_object();
 		validation_object() = delete;
 		validation_object& operator=(const validation_object&) = delete;
-		validation_object& operator=(validation_object&&) = default;
+		validation_object& operator=(validation_object&& other) noexcept;
 
 		size_t child_count() const noexcept { return m_childValidation.size(); }
 		/// <summary>
@@ -197,11 +215,11 @@ namespace validation
 		/// <summary>
 		/// An identifier for the type of error being raised.
 		/// </summary>
-		const std::string& errorIdentifier() const { return m_errorIdentifier; }
+		const std::string& errorIdentifier() const { return *m_errorIdentifier; }
 		/// <summary>
 		/// The name of the protobuf object type that is raising an error.
 		/// </summary>
-		const std::string& protobufObject() const { return m_protobufObject; }
+		const std::string& protobufObject() const { return *m_protobufObject; }
 		/// <summary>
 		/// The value that caused the error. Will only be serialized if there are no children.
 		/// </summary>
@@ -230,11 +248,38 @@ namespace validation
 		/// <summary>
 		/// Child validation results.
 		/// </summary>
-		const std::list<std::shared_ptr<validation::validation_object>>& children() const { return m_childValidation; }
+		const std::vector<std::shared_ptr<validation::validation_object>>& children() const { return m_childValidation; }
+		/// <summary>
+		/// The child at index, without the reference counting of children() or operator[]. Valid for as long as
+		/// this node is.
+		/// </summary>
+		validation_object* child(size_t index) noexcept { return m_childValidation[index].get(); }
+		/// <summary>
+		/// The child at index, without the reference counting of children() or operator[]. Valid for as long as
+		/// this node is.
+		/// </summary>
+		const validation_object* child(size_t index) const noexcept { return m_childValidation[index].get(); }
+
+		/// <summary>
+		/// Report errors added to this node, and nodes added to it afterwards, to a sink. The sink may filter
+		/// errors out before they are added. Set it on the root before building the tree, it must outlive the tree.
+		/// </summary>
+		void set_sink(validation_sink* sink) noexcept { m_sink = sink; }
+		validation_sink* sink() const noexcept { return m_sink; }
+		/// <summary>
+		/// True if the sink attached to this node has asked for validation to stop.
+		/// </summary>
+		bool should_abort() const noexcept;
+
+		/// <summary>
+		/// Move all of source's children to the end of this node's children, keeping their order.
+		/// </summary>
+		/// <param name="source">The node to take the children from. It is left with no children.</param>
+		void merge_children(validation_object&& source);
 
 		std::weak_ptr<validation::validation_object> operator[](std::uint32_t index)
 		{
-			return std::weak_ptr<validation::validation_object>(*std::next(m_childValidation.begin(), index));
+			return std::weak_ptr<validation::validation_object>(m_childValidation[index]);
 		}
 
 	protected:
@@ -243,13 +288,13 @@ namespace validation
 		/// </summary>
 		error_level m_errorLevel{ error_level::NONE };
 		/// <summary>
-		/// An identifier for the type of error being raised.
+		/// An identifier for the type of error being raised, interned.
 		/// </summary>
-		std::string m_errorIdentifier;
+		const std::string* m_errorIdentifier;
 		/// <summary>
-		/// The name of the protobuf object type that is raising an error.
+		/// The name of the protobuf object type that is raising an error, interned.
 		/// </summary>
-		std::string m_protobufObject;
+		const std::string* m_protobufObject;
 		/// <summary>
 		/// The value that caused the error. Will only be serialized if there are no children.
 		/// </summary>
@@ -261,7 +306,7 @@ namespace validation
 		/// <summary>
 		/// Child validation results.
 		/// </summary>
-		std::list<std::shared_ptr<validation::validation_object>> m_childValidation;
+		std::vector<std::shared_ptr<validation::validation_object>> m_childValidation;
 		/// <summary>
 		/// An optional minimum value for the range of allowed values.
 		/// </summary>
@@ -278,6 +323,41 @@ namespace validation
 		/// An optional error message describing the logic that caused the issue.
 		/// </summary>
 		std::optional<std::string> m_errorMessage;
+		/// <summary>
+		/// The node that this node is a child of, null for a root node.
+		/// </summary>
+		validation_object* m_parent{ nullptr };
+		/// <summary>
+		/// The number of nodes in this branch at each error level, indexed by error_level. Not synchronized, see
+		/// the single writer rule on the class.
+		/// </summary>
+		size_t m_levelCounts[4]{ 1, 0, 0, 0 };
+		/// <summary>
+		/// Where errors are reported as they are raised, inherited by children.
+		/// </summary>
+		validation_sink* m_sink{ nullptr };
+
+		/// <summary>
+		/// Check the arguments for a new error node, so they are rejected before they reach the sink.
+		/// </summary>
+		static void validate(const std::string& protobufObject, const std::string* names, size_t name_count, std::string_view errorIdentifier,
+			size_t value_count);
+		/// <summary>
+		/// Pass an error to the sink, if there is one.
+		/// </summary>
+		/// <returns>False if the sink filtered out the error and no node should be created for it.</returns>
+		bool report(const std::string& protobufObject, const std::string* names, size_t name_count, error_level level, std::string_view errorIdentifier,
+			const std::string* values, size_t value_count, std::string_view errorMessage) const;
+
+		/// <summary>
+		/// Add (or remove) a branch's level counts to every ancestor of this node.
+		/// </summary>
+		void propagate_counts(const size_t(&counts)[4], bool add) noexcept;
+		/// <summary>
+		/// Leave a moved from node as an empty node with no error, keeping its ancestors' counts consistent.
+		/// </summary>
+		void reset_moved() noexcept;
+		void set_error_level(error_level level) noexcept;
 
 		void make_error(error_level level, std::string_view errorIdentifier, const std::string& value);
 		void make_error(error_level level, std::string_view errorIdentifier, std::initializer_list<std::string>&& value);
@@ -289,6 +369,43 @@ namespace validation
 		std::weak_ptr<validation::validation_object> add_child_validation(validation_object&& child);
 	};
 
+	/// <summary>
+	/// Collects validation results from several threads into one parent. Each unit of work reports into its own
+	/// slot, which only that work may use, so no locking is needed while validating. The slots are appended to the
+	/// parent in slot order when merge is called (or the collector is destroyed), so the order of the children doesn't
+	/// depend on which thread finished first.
+	/// </summary>
+	class concurrent_collector
+	{
+	public:
+		/// <summary>
+		/// Create a collector.
+		/// </summary>
+		/// <param name="parent">The node to add the collected children to. If null, every slot is null too.</param>
+		/// <param name="slots">The number of independent units of work that will report results.</param>
+		concurrent_collector(validation_object* parent, size_t slots);
+		concurrent_collector(const concurrent_collector&) = delete;
+		concurrent_collector& operator=(const concurrent_collector&) = delete;
+		~concurrent_collector();
+
+		size_t slot_count() const noexcept { return m_slotCount; }
+		/// <summary>
+		/// The node that unit of work index should add its children to, or null if there is no parent. Only
+		/// one thread at a time may use a given slot.
+		/// </summary>
+		validation_object* slot(size_t index) noexcept { return m_parent ? &m_slots[index] : nullptr; }
+		/// <summary>
+		/// Append the children of every slot to the parent, in slot order. Must not be called while any thread
+		/// is still using a slot. Safe to call more than once, later calls only merge what was added since.
+		/// </summary>
+		void merge();
+
+	private:
+		validation_object* m_parent;
+		size_t m_slotCount;
+		std::vector<validation_object> m_slots;
+	};
+
 	/// <summary>
 	/// Create a new validation object only if the parent exists.
 	/// </summary>
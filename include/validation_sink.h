@@ -0,0 +1,171 @@
+/**
+ * validation_sink.h
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "validation_object.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+
+#ifdef _MSC_VER
+
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(push, off)
+#endif
+#endif //_MSC_VER
+
+
+namespace validation
+{
+	/// <summary>
+	/// An error as it is raised, before any node is created for it. Only valid for the duration of the
+	/// validation_sink::on_error call.
+	/// </summary>
+	struct validation_event
+	{
+		/// <summary>
+		/// The node the error is being added to.
+		/// </summary>
+		const validation_object* parent;
+		std::string_view protobufObject;
+		std::string_view errorIdentifier;
+		error_level level;
+		/// <summary>
+		/// The object names, name_count of them.
+		/// </summary>
+		const std::string* names;
+		size_t name_count;
+		/// <summary>
+		/// The values that caused the error, value_count of them.
+		/// </summary>
+		const std::string* values;
+		size_t value_count;
+		/// <summary>
+		/// An optional message, empty if none was given.
+		/// </summary>
+		std::string_view errorMessage;
+	};
+
+	/// <summary>
+	/// Receives validation errors as they are raised. Attach to the root of a tree with validation_object::set_sink,
+	/// every node added to that tree afterwards reports to the same sink. on_error may be called from several threads
+	/// at once (ex. through a concurrent_collector) so implementations must be thread safe.
+	/// </summary>
+	class validation_sink
+	{
+	public:
+		/// <summary>
+		/// Create a sink.
+		/// </summary>
+		/// <param name="min_level">Errors below this level are dropped, they are neither reported nor added to the tree.</param>
+		/// <param name="abort_on_severe">If true, should_abort will return true once a SEVERE error has been raised.</param>
+		/// <param name="materialize">If false, errors are only reported to the sink and not added to the tree.</param>
+		validation_sink(error_level min_level = error_level::NONE, bool abort_on_severe = false, bool materialize = true) noexcept
+			: m_minLevel(min_level), m_abortOnSevere(abort_on_severe), m_materialize(materialize) { }
+		validation_sink(const validation_sink&) = delete;
+		validation_sink& operator=(const validation_sink&) = delete;
+		virtual ~validation_sink() = default;
+
+		error_level min_level() const noexcept { return m_minLevel; }
+		bool materialize() const noexcept { return m_materialize; }
+		/// <summary>
+		/// Whether the work producing errors should stop. Cheap enough to poll per record.
+		/// </summary>
+		bool should_abort() const noexcept { return m_abort.load(std::memory_order_relaxed); }
+		void request_abort() noexcept { m_abort.store(true, std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Filter and report an error.
+		/// </summary>
+		/// <returns>True if a node should be created for the error.</returns>
+		bool raise(const validation_event& event);
+
+	protected:
+		/// <summary>
+		/// Called for each error at or above the minimum level.
+		/// </summary>
+		virtual void on_error(const validation_event& event) = 0;
+
+	private:
+		error_level m_minLevel;
+		bool m_abortOnSevere;
+		bool m_materialize;
+		std::atomic<bool> m_abort{ false };
+	};
+
+	/// <summary>
+	/// Counts the errors raised at each level.
+	/// </summary>
+	class counting_sink : public validation_sink
+	{
+	public:
+		using validation_sink::validation_sink;
+
+		size_t count(error_level level) const noexcept { return m_counts[static_cast<size_t>(level)].load(std::memory_order_relaxed); }
+
+	protected:
+		void on_error(const validation_event& event) override;
+
+	private:
+		std::atomic<size_t> m_counts[4]{};
+	};
+
+	/// <summary>
+	/// Passes each error to a function. The function is serialized by the sink so doesn't need to be thread safe itself.
+	/// </summary>
+	class callback_sink : public validation_sink
+	{
+	public:
+		callback_sink(std::function<void(const validation_event&)> callback, error_level min_level = error_level::NONE, bool abort_on_severe = false, bool materialize = true)
+			: validation_sink(min_level, abort_on_severe, materialize), m_callback(std::move(callback)) { }
+
+	protected:
+		void on_error(const validation_event& event) override;
+
+	private:
+		std::function<void(const validation_event&)> m_callback;
+		std::mutex m_lock;
+	};
+
+	/// <summary>
+	/// Writes each error as a line of text to a stream (ex. a log file).
+	/// </summary>
+	class stream_sink : public validation_sink
+	{
+	public:
+		stream_sink(std::ostream& stream, error_level min_level = error_level::NONE, bool abort_on_severe = false, bool materialize = true)
+			: validation_sink(min_level, abort_on_severe, materialize), m_stream(stream) { }
+
+	protected:
+		void on_error(const validation_event& event) override;
+
+	private:
+		std::ostream& m_stream;
+		std::mutex m_lock;
+	};
+}
+
+#ifdef _MSC_VER
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(pop)
+#endif
+#endif
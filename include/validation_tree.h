@@ -0,0 +1,378 @@
+/**
+ * validation_tree.h
+ *
+ * Copyright 2020-2023 Heartland Software Solutions Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the license at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the LIcense is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "validation_object.h"
+
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _MSC_VER
+
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(push, off)
+#endif
+#endif //_MSC_VER
+
+
+namespace validation
+{
+	/// <summary>
+	/// The index of a node in a validation_tree.
+	/// </summary>
+	using node_index = std::uint32_t;
+	constexpr node_index invalid_node = UINT32_MAX;
+
+	/// <summary>
+	/// A flat alternative to a tree of validation_objects. Every node lives in one contiguous array and refers to
+	/// its parent, first child and next sibling by index, and every string is stored once in an intern table. Adding
+	/// a node doesn't allocate unless one of the arrays has to grow or a string is new, so building trees with hundreds
+	/// of thousands of nodes costs a handful of allocations instead of several per node.
+	///
+	/// Nodes are read through node_ref, which has the same accessors as validation_object. Nodes can't be removed.
+	/// </summary>
+	class validation_tree
+	{
+	private:
+		static constexpr std::uint32_t no_string = UINT32_MAX;
+		static constexpr std::uint32_t no_range = UINT32_MAX;
+
+		struct node_type
+		{
+			node_index parent;
+			node_index first_child;
+			node_index last_child;
+			node_index next_sibling;
+			std::uint32_t child_count;
+			std::uint32_t protobuf_object;
+			std::uint32_t error_identifier;
+			std::uint32_t names_offset;			// offset into m_stringLists
+			std::uint32_t names_count;
+			std::uint32_t values_offset;		// offset into m_stringLists
+			std::uint32_t values_count;
+			std::uint32_t units;
+			std::uint32_t error_message;
+			std::uint32_t range;				// index into m_ranges
+			error_level level;
+		};
+
+		struct range_pair
+		{
+			std::optional<range_type> minimum;
+			std::optional<range_type> maximum;
+		};
+
+	public:
+		class node_ref;
+
+		/// <summary>
+		/// A read only list of interned strings, used in place of the std::list&lt;std::string&gt; of validation_object.
+		/// </summary>
+		class string_range
+		{
+		public:
+			class iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = std::string;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string*;
+				using reference = const std::string&;
+
+				iterator(const validation_tree* tree, const std::uint32_t* id) noexcept : m_tree(tree), m_id(id) { }
+
+				reference operator*() const { return m_tree->string(*m_id); }
+				pointer operator->() const { return &m_tree->string(*m_id); }
+				iterator& operator++() noexcept { ++m_id; return *this; }
+				iterator operator++(int) noexcept { iterator i(*this); ++m_id; return i; }
+				difference_type operator-(const iterator& other) const noexcept { return m_id - other.m_id; }
+				bool operator==(const iterator& other) const noexcept { return m_id == other.m_id; }
+				bool operator!=(const iterator& other) const noexcept { return m_id != other.m_id; }
+
+			private:
+				const validation_tree* m_tree;
+				const std::uint32_t* m_id;
+			};
+
+			string_range(const validation_tree* tree, const std::uint32_t* first, std::uint32_t count) noexcept : m_tree(tree), m_first(first), m_count(count) { }
+
+			iterator begin() const noexcept { return iterator(m_tree, m_first); }
+			iterator end() const noexcept { return iterator(m_tree, m_first + m_count); }
+			size_t size() const noexcept { return m_count; }
+			bool empty() const noexcept { return m_count == 0; }
+			const std::string& front() const { return m_tree->string(m_first[0]); }
+			const std::string& back() const { return m_tree->string(m_first[m_count - 1]); }
+			const std::string& operator[](size_t index) const { return m_tree->string(m_first[index]); }
+
+		private:
+			const validation_tree* m_tree;
+			const std::uint32_t* m_first;
+			std::uint32_t m_count;
+		};
+
+		/// <summary>
+		/// The children of a node, iterated in the order they were added.
+		/// </summary>
+		class child_range
+		{
+		public:
+			class iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = node_ref;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const node_ref*;
+				using reference = node_ref;
+
+				iterator(const validation_tree* tree, node_index index) noexcept : m_tree(tree), m_index(index) { }
+
+				node_ref operator*() const noexcept { return node_ref(m_tree, m_index); }
+				iterator& operator++() noexcept { m_index = m_tree->m_nodes[m_index].next_sibling; return *this; }
+				iterator operator++(int) noexcept { iterator i(*this); ++(*this); return i; }
+				bool operator==(const iterator& other) const noexcept { return m_index == other.m_index; }
+				bool operator!=(const iterator& other) const noexcept { return m_index != other.m_index; }
+
+			private:
+				const validation_tree* m_tree;
+				node_index m_index;
+			};
+
+			child_range(const validation_tree* tree, node_index first, std::uint32_t count) noexcept : m_tree(tree), m_first(first), m_count(count) { }
+
+			iterator begin() const noexcept { return iterator(m_tree, m_first); }
+			iterator end() const noexcept { return iterator(m_tree, invalid_node); }
+			size_t size() const noexcept { return m_count; }
+			bool empty() const noexcept { return m_count == 0; }
+
+		private:
+			const validation_tree* m_tree;
+			node_index m_first;
+			std::uint32_t m_count;
+		};
+
+		/// <summary>
+		/// A reference to a node in the tree, with the same read accessors as validation_object. Remains
+		/// valid as long as the tree does, even if more nodes are added.
+		/// </summary>
+		class node_ref
+		{
+		public:
+			node_ref(const validation_tree* tree, node_index index) noexcept : m_tree(tree), m_index(index) { }
+
+			/// <summary>
+			/// Allows code written against the shared_ptr children of validation_object to use -> unchanged.
+			/// </summary>
+			const node_ref* operator->() const noexcept { return this; }
+
+			node_index index() const noexcept { return m_index; }
+			node_index parent() const noexcept { return node().parent; }
+
+			/// <summary>
+			/// The maximum error level of this node and its children.
+			/// </summary>
+			error_level max_error_level() const noexcept { return m_tree->max_error_level(m_index); }
+			size_t child_count() const noexcept { return node().child_count; }
+			/// <summary>
+			/// The error level of this node.
+			/// </summary>
+			error_level errorLevel() const noexcept { return node().level; }
+			/// <summary>
+			/// An identifier for the type of error being raised, empty if this node isn't an error.
+			/// </summary>
+			const std::string& errorIdentifier() const { return m_tree->string(node().error_identifier); }
+			/// <summary>
+			/// The name of the protobuf object type that is raising an error.
+			/// </summary>
+			const std::string& protobufObject() const { return m_tree->string(node().protobuf_object); }
+			/// <summary>
+			/// The value that caused the error.
+			/// </summary>
+			string_range errorValue() const noexcept { return string_range(m_tree, m_tree->m_stringLists.data() + node().values_offset, node().values_count); }
+			/// <summary>
+			/// The object identifier/name (not type) that is associated with this error
+			/// </summary>
+			string_range objectName() const noexcept { return string_range(m_tree, m_tree->m_stringLists.data() + node().names_offset, node().names_count); }
+			/// <summary>
+			/// An optional minimum value for the range of allowed values.
+			/// </summary>
+			const std::optional<range_type>& minimum() const noexcept { return m_tree->range(m_index).minimum; }
+			/// <summary>
+			/// An optional maximum value for the range of allowed values.
+			/// </summary>
+			const std::optional<range_type>& maximum() const noexcept { return m_tree->range(m_index).maximum; }
+			/// <summary>
+			/// An optional string describing units for minimum, maximum.
+			/// </summary>
+			std::optional<std::string_view> units() const { return m_tree->optional_string(node().units); }
+			/// <summary>
+			/// An optional message that is associated with this error.
+			/// </summary>
+			std::optional<std::string_view> errorMessage() const { return m_tree->optional_string(node().error_message); }
+			/// <summary>
+			/// Child validation results.
+			/// </summary>
+			child_range children() const noexcept { return child_range(m_tree, node().first_child, node().child_count); }
+			/// <summary>
+			/// The child at index. Walks the sibling chain so is linear in index.
+			/// </summary>
+			node_ref operator[](std::uint32_t index) const noexcept;
+
+		private:
+			const validation_tree* m_tree;
+			node_index m_index;
+
+			const node_type& node() const noexcept { return m_tree->m_nodes[m_index]; }
+		};
+
+	public:
+		/// <summary>
+		/// Create a tree with a root node that is not an error.
+		/// </summary>
+		/// <param name="protobufObject">The name of the protobuf object type that the root is being created for.</param>
+		/// <param name="name">The object name that the root is being created for.</param>
+		validation_tree(std::string_view protobufObject, std::string_view name);
+		/// <summary>
+		/// Flatten an existing tree of validation_objects.
+		/// </summary>
+		explicit validation_tree(const validation_object& root);
+		validation_tree(const validation_tree&) = delete;
+		validation_tree(validation_tree&&) = default;
+		validation_tree& operator=(const validation_tree&) = delete;
+		validation_tree& operator=(validation_tree&&) = default;
+
+		/// <summary>
+		/// Reserve space for node_count nodes, to avoid growing the node array while building a tree of known size.
+		/// </summary>
+		void reserve(size_t node_count);
+		/// <summary>
+		/// The total number of nodes in the tree, including the root.
+		/// </summary>
+		size_t size() const noexcept { return m_nodes.size(); }
+		/// <summary>
+		/// The number of distinct strings stored by the tree.
+		/// </summary>
+		size_t string_count() const noexcept { return m_strings.size(); }
+
+		node_ref root() const noexcept { return node_ref(this, 0); }
+		node_ref node(node_index index) const noexcept { return node_ref(this, index); }
+		error_level max_error_level() const noexcept { return max_error_level(0); }
+
+		/// <summary>
+		/// Add a child node that is not an error but may contain children that are errors.
+		/// </summary>
+		/// <param name="parent">The node to add the child to.</param>
+		/// <param name="protobufObject">The name of the protobuf object type that the node is being created for.</param>
+		/// <param name="name">The object name that the error is being created for.</param>
+		/// <returns>The newly added node.</returns>
+		node_index add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name);
+		/// <summary>
+		/// Add a child node that is an error.
+		/// </summary>
+		/// <param name="parent">The node to add the child to.</param>
+		/// <param name="protobufObject">The name of the protobuf object type that the node is being created for.</param>
+		/// <param name="name">The object name that the error is being created for.</param>
+		/// <param name="level">The severity of the error.</param>
+		/// <param name="errorIdentifier">An identifier for the type of error being raised.</param>
+		/// <param name="value">The value that caused the error.</param>
+		/// <returns>The newly added node.</returns>
+		node_index add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name, error_level level, std::string_view errorIdentifier, std::string_view value);
+		/// <summary>
+		/// Add a child node that is an error.
+		/// </summary>
+		/// <param name="parent">The node to add the child to.</param>
+		/// <param name="protobufObject">The name of the protobuf object type that the node is being created for.</param>
+		/// <param name="names">An array of object names that the error is being created for.</param>
+		/// <param name="level">The severity of the error.</param>
+		/// <param name="errorIdentifier">An identifier for the type of error being raised.</param>
+		/// <param name="values">The values that caused the error. The length of this list must match <paramref name="names"/>.</param>
+		/// <returns>The newly added node.</returns>
+		node_index add_child_validation(node_index parent, std::string_view protobufObject, std::initializer_list<std::string_view> names, error_level level, std::string_view errorIdentifier, std::initializer_list<std::string_view> values);
+		/// <summary>
+		/// Add a child node that is an error.
+		/// </summary>
+		/// <param name="parent">The node to add the child to.</param>
+		/// <param name="protobufObject">The name of the protobuf object type that the node is being created for.</param>
+		/// <param name="name">The object name that the error is being created for.</param>
+		/// <param name="level">The severity of the error.</param>
+		/// <param name="errorIdentifier">An identifier for the type of error being raised.</param>
+		/// <param name="value">The value that caused the error.</param>
+		/// <param name="errorMessage">Additional error descriptor to help the client code resolve the issue (describes logic).</param>
+		/// <returns>The newly added node.</returns>
+		node_index add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name, error_level level, std::string_view errorIdentifier, std::string_view value, std::string_view errorMessage);
+		/// <summary>
+		/// Add a child node that is an error.
+		/// </summary>
+		/// <param name="parent">The node to add the child to.</param>
+		/// <param name="protobufObject">The name of the protobuf object type that the node is being created for.</param>
+		/// <param name="name">The object name that the error is being created for.</param>
+		/// <param name="level">The severity of the error.</param>
+		/// <param name="errorIdentifier">An identifier for the type of error being raised.</param>
+		/// <param name="value">The value that caused the error.</param>
+		/// <param name="min">The minimum value in a range of acceptable values.</param>
+		/// <param name="max">The maximum value in a range of acceptable values.</param>
+		/// <param name="errorMessage">Additional error descriptor to help the client code resolve the issue (describes logic).</param>
+		/// <returns>The newly added node.</returns>
+		node_index add_child_validation(node_index parent, std::string_view protobufObject, std::string_view name, error_level level, std::string_view errorIdentifier, std::string_view value, range_type minimum, range_type maximum, std::string_view units = "", std::string_view errorMessage = "");
+
+	private:
+		/// <summary>
+		/// The nodes, the root is always at index 0 and a child always follows its parent.
+		/// </summary>
+		std::vector<node_type> m_nodes;
+		/// <summary>
+		/// Runs of string ids for the names and values of each node.
+		/// </summary>
+		std::vector<std::uint32_t> m_stringLists;
+		/// <summary>
+		/// Range information, only for the nodes that have it.
+		/// </summary>
+		std::vector<range_pair> m_ranges;
+		/// <summary>
+		/// The interned strings, a deque so references remain valid as more are added.
+		/// </summary>
+		std::deque<std::string> m_strings;
+		std::unordered_map<std::string_view, std::uint32_t> m_stringIds;
+
+		std::uint32_t intern(std::string_view str);
+		std::uint32_t intern_list(std::initializer_list<std::string_view> strs);
+		const std::string& string(std::uint32_t id) const { return m_strings[id]; }
+		std::optional<std::string_view> optional_string(std::uint32_t id) const;
+		const range_pair& range(node_index index) const noexcept;
+		error_level max_error_level(node_index index) const noexcept;
+
+		node_index add_node(node_index parent, std::string_view protobufObject, std::uint32_t names_offset, std::uint32_t names_count);
+		void check_node(node_index parent, std::string_view protobufObject, std::initializer_list<std::string_view> names) const;
+		static void check_error(std::string_view errorIdentifier);
+		void make_error(node_index index, error_level level, std::string_view errorIdentifier, std::uint32_t values_offset, std::uint32_t values_count);
+		void copy_error(node_index index, const validation_object& source);
+		void copy_children(node_index parent, const validation_object& source);
+	};
+}
+
+#ifdef _MSC_VER
+#if (!defined(__INTEL_COMPILER)) && (!defined(__INTEL_LLVM_COMPILER))
+#pragma managed(pop)
+#endif
+#endif
@@ -1,11 +1,52 @@
 #include <gtest/gtest.h>
 
 #include <iostream>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "convert.h"
+#include "Dlgcnvt.h"
+#include "validation_tree.h"
+#include "validation_sink.h"
+#include "validation_binary.h"
+#include "pevents.h"
+#include "thread_pool.h"
+#include "AfxIniSettings.h"
+#include "filesystem.hpp"
+#include "propsysreplacement.h"
+#include "numeric_column.h"
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 
 namespace
 {
+// the fmod based implementations from convert.cpp that the inlined/vectorized versions replace
+double legacyNormalizeAngleRadian(double number)
+{
+	const double base = 6.28318530717958647692529;
+	if (number >= 0.0) {
+		if (number < base)
+			return number;
+		return fmod(number, base);
+	}
+	return fmod(number, base) + base;
+}
+
+double legacyCartesianToCompassRadian(double x)
+{
+	return legacyNormalizeAngleRadian(7.85398163397448309615661 - x);
+}
+
 TEST(LowlevelTest, TestUnitConversion1)
 {
 	double ft = UnitConvert::convertUnit(5.0, STORAGE_FORMAT_FOOT, STORAGE_FORMAT_M);
@@ -19,4 +60,1306 @@ TEST(LowlevelTest, TestUnitConversion2)
 
 	EXPECT_NEAR(16.4042, ft, 0.0001);
 }
-}
\ No newline at end of file
+
+TEST(LowlevelTest, TestUnitConversionStringView)
+{
+	auto result = UnitConvert::tryConvertUnit(" -1.5e3 m ", STORAGE_FORMAT_KM);
+
+	EXPECT_TRUE(result.ok());
+	EXPECT_EQ(STORAGE_FORMAT_M, result.from_format);
+	EXPECT_NEAR(-1.5, result.value, 0.0000001);
+
+	result = UnitConvert::tryConvertUnit("+2", STORAGE_FORMAT_M, STORAGE_FORMAT_KM);
+	EXPECT_TRUE(result.ok());
+	EXPECT_NEAR(2000.0, result.value, 0.0000001);
+}
+
+TEST(LowlevelTest, TestUnitConversionStringViewErrors)
+{
+	EXPECT_EQ(UnitConvert::ConvertError::NO_VALUE, UnitConvert::parseUnit("  ").error);
+	EXPECT_EQ(UnitConvert::ConvertError::INVALID_VALUE, UnitConvert::parseUnit("m5").error);
+	EXPECT_EQ(UnitConvert::ConvertError::UNKNOWN_UNIT, UnitConvert::parseUnit("5 furlongs").error);
+	EXPECT_EQ(UnitConvert::ConvertError::UNKNOWN_UNIT, UnitConvert::parseUnit("5").error);
+
+	int ierr;
+	UnitConvert::convertUnit(toTString("5 furlongs"), STORAGE_FORMAT_M, &ierr);
+	EXPECT_EQ(1, ierr);
+}
+
+TEST(LowlevelTest, TestUnitNameView)
+{
+	const UnitConvert::STORAGE_UNIT intensity = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KILOWATT_SECOND << 0x20) | STORAGE_FORMAT_M;
+	auto name = UnitConvert::UnitNameView(intensity, true);
+
+	EXPECT_EQ(toStdString(UnitConvert::UnitName(intensity, true)), name);
+	EXPECT_EQ(name.data(), UnitConvert::UnitNameView(intensity, true).data());
+	EXPECT_EQ("kilometer", UnitConvert::UnitNameView(STORAGE_FORMAT_KM, false));
+}
+
+TEST(LowlevelTest, TestAngleKernelsScalar)
+{
+	for (double x = -50.0; x <= 50.0; x += 0.0137)
+	{
+		EXPECT_NEAR(legacyNormalizeAngleRadian(x), UnitConvert::normalizeAngleRadian(x), 1e-12);
+		EXPECT_NEAR(legacyCartesianToCompassRadian(x), UnitConvert::cartesianToCompassRadian(x), 1e-12);
+		EXPECT_NEAR((x / 180.0) * 3.14159265358979323846264, UnitConvert::degreeToRadian(x), 1e-12);
+	}
+	EXPECT_NEAR(legacyNormalizeAngleRadian(1e20), UnitConvert::normalizeAngleRadian(1e20), 1e-12);
+	EXPECT_TRUE(std::isnan(UnitConvert::normalizeAngleRadian(NAN)));
+}
+
+TEST(LowlevelTest, TestAngleKernelsArray)
+{
+	std::vector<double> in;
+	for (double x = -1000.0; x <= 1000.0; x += 0.731)
+		in.push_back(x);
+	// either side of the limit for the truncation, and far past it
+	for (double x = 1.0; x < 1e17; x *= 3.7)
+	{
+		in.push_back(x + 0.3);
+		in.push_back(-x - 0.3);
+	}
+	in.push_back(6588397.3);
+	in.push_back(-6588397.3);
+	in.push_back(1e12);
+	in.push_back(-3e10);
+	in.push_back(1e16);
+	in.push_back(1e20);
+	std::vector<double> out(in.size());
+
+	UnitConvert::normalizeAngleRadian(in.data(), out.data(), in.size());
+	for (size_t i = 0; i < in.size(); i++)
+		EXPECT_NEAR(legacyNormalizeAngleRadian(in[i]), out[i], 1e-12) << in[i];
+
+	UnitConvert::cartesianToCompassRadian(in.data(), out.data(), in.size());
+	for (size_t i = 0; i < in.size(); i++)
+		EXPECT_NEAR(legacyCartesianToCompassRadian(in[i]), out[i], 1e-12) << in[i];
+
+	std::vector<double> inplace = in;
+	UnitConvert::radianToDegree(inplace.data(), inplace.data(), inplace.size());
+	for (size_t i = 0; i < in.size(); i++)
+		EXPECT_DOUBLE_EQ(UnitConvert::radianToDegree(in[i]), inplace[i]);
+}
+
+TEST(LowlevelTest, TestUnitConversionColumns)
+{
+	UnitConversion conversion(_T(""));
+	conversion.TempDisplay(STORAGE_FORMAT_FAHRENHEIT);
+	conversion.AngleDisplay(STORAGE_FORMAT_ANGLE | STORAGE_FORMAT_DEGREE | STORAGE_FORMAT_COMPASS);
+
+	const size_t rows = 50000;
+	std::vector<double> distance(rows), temp(rows), angle(rows), velocity(rows);
+	for (size_t i = 0; i < rows; i++)
+	{
+		distance[i] = i * 1.5;
+		temp[i] = -40.0 + i * 0.01;
+		angle[i] = -10.0 + i * 0.001;
+		velocity[i] = i * 0.25;
+	}
+	std::vector<double> distance_out(rows), angle_out(rows), velocity_out(rows), temp_out = temp;
+
+	UnitConversion::Column columns[] = {
+		{ distance.data(), distance_out.data(), STORAGE_FORMAT_M, UnitConversion::Category::Distance },
+		{ temp_out.data(), temp_out.data(), STORAGE_FORMAT_CELSIUS, UnitConversion::Category::Temp },
+		{ angle.data(), angle_out.data(), STORAGE_FORMAT_ANGLE | STORAGE_FORMAT_RADIAN | STORAGE_FORMAT_CARTESIAN, UnitConversion::Category::Angle },
+		{ velocity.data(), velocity_out.data(), STORAGE_FORMAT_M | STORAGE_FORMAT_SECOND, UnitConversion::Category::Velocity },
+	};
+	conversion.ConvertColumns(columns, 4, rows);
+
+	for (size_t i = 0; i < rows; i++)
+	{
+		EXPECT_NEAR(UnitConversion::ConvertUnit(distance[i], STORAGE_FORMAT_M, conversion.DistanceDisplay()), distance_out[i], 1e-9);
+		EXPECT_NEAR(UnitConversion::ConvertUnit(temp[i], STORAGE_FORMAT_CELSIUS, STORAGE_FORMAT_FAHRENHEIT), temp_out[i], 1e-9);
+		EXPECT_NEAR(UnitConversion::ConvertUnit(angle[i], columns[2].storage, conversion.AngleDisplay()), angle_out[i], 1e-9);
+		EXPECT_NEAR(UnitConversion::ConvertUnit(velocity[i], columns[3].storage, conversion.VelocityDisplay()), velocity_out[i], 1e-9);
+	}
+	EXPECT_NEAR(1.5, distance_out[1000], 1e-12);
+	EXPECT_NEAR(-40.0, temp_out[0], 1e-12);
+}
+
+TEST(LowlevelTest, TestUnitConversionSnapshot)
+{
+	UnitConversion conversion(_T(""));
+	const UnitConversion::Profile& before = conversion.Snapshot();
+	conversion.DistanceDisplay(STORAGE_FORMAT_MILE);
+	EXPECT_EQ(STORAGE_FORMAT_KM, before.distance_display);
+	EXPECT_EQ(STORAGE_FORMAT_MILE, conversion.DistanceDisplay());
+	EXPECT_EQ(STORAGE_FORMAT_MILE, conversion.Display(UnitConversion::Category::Distance));
+
+	UnitConversion copy(conversion);
+	conversion.ResetToDefaults();
+	EXPECT_EQ(STORAGE_FORMAT_MILE, copy.DistanceDisplay());
+	EXPECT_EQ(STORAGE_FORMAT_KM, conversion.DistanceDisplay());
+	copy = conversion;
+	EXPECT_EQ(STORAGE_FORMAT_KM, copy.DistanceDisplay());
+
+	EXPECT_TRUE(conversion.SetDisplayLanguage("fr-ca"));
+	EXPECT_EQ("fr", conversion.DisplayPrimaryLanguage());
+
+	//setting what's already there doesn't publish a new profile
+	const UnitConversion::Profile* current = &conversion.Snapshot();
+	conversion.DistanceDisplay(STORAGE_FORMAT_KM);
+	conversion.SetDisplayLanguage("fr-ca");
+	copy = conversion;
+	EXPECT_EQ(current, &conversion.Snapshot());
+
+	//going back to a profile that was used before reuses it
+	conversion.DistanceDisplay(STORAGE_FORMAT_MILE);
+	const UnitConversion::Profile* mile = &conversion.Snapshot();
+	for (int i = 0; i < 100; i++)
+		conversion.DistanceDisplay((i & 1) ? STORAGE_FORMAT_MILE : STORAGE_FORMAT_KM);
+	EXPECT_EQ(mile, &conversion.Snapshot());
+	conversion.DistanceDisplay(STORAGE_FORMAT_KM);
+	EXPECT_EQ(current, &conversion.Snapshot());
+}
+
+TEST(LowlevelTest, TestUnitConversionLockFreeReads)
+{
+	//readers load a plain pointer, they don't take the writer's lock or any other
+	struct Probe : public UnitConversion
+	{
+		Probe() : UnitConversion(_T("")) { }
+		bool lockFree() const { return m_profile.is_lock_free(); }
+		std::mutex& writeLock() const { return m_writeLock; }
+	};
+	Probe conversion;
+	EXPECT_TRUE(conversion.lockFree());
+
+	std::atomic<bool> read(false);
+	{
+		std::lock_guard<std::mutex> lock(conversion.writeLock());
+		std::thread reader([&conversion, &read]()
+		{
+			const UnitConversion::Profile& profile = conversion.Snapshot();
+			read = (profile.distance_display == conversion.DistanceDisplay()) && (conversion.Display(UnitConversion::Category::Distance) == STORAGE_FORMAT_KM);
+		});
+		reader.join();
+	}
+	EXPECT_TRUE(read.load());
+}
+
+TEST(LowlevelTest, TestUnitConversionConcurrentProfiles)
+{
+	UnitConversion conversion(_T(""));
+	const UnitConvert::STORAGE_UNIT a = ((UnitConvert::STORAGE_UNIT)STORAGE_FORMAT_KILOWATT_SECOND << 0x20) | STORAGE_FORMAT_M;
+	const UnitConvert::STORAGE_UNIT b = ((UnitConvert::STORAGE_UNIT)UnitConvert::STORAGE_FORMAT_BTU_PER_SECOND << 0x20) | STORAGE_FORMAT_FOOT;
+	UnitConversion first(_T("")), second(_T(""));
+	first.IntensityDisplay(a);
+	second.IntensityDisplay(b);
+	second.DistanceDisplay(STORAGE_FORMAT_MILE);
+	conversion = first;
+
+	std::atomic<bool> done(false);
+	std::atomic<int> torn(0);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; i++)
+		readers.emplace_back([&]()
+		{
+			while (!done.load())
+			{
+				const UnitConversion::Profile& profile = conversion.Snapshot();
+				UnitConvert::STORAGE_UNIT intensity = profile.intensity_display;
+				if ((intensity != a) && (intensity != b))
+					torn++;
+				if ((intensity == a) != (profile.distance_display == STORAGE_FORMAT_KM))
+					torn++;
+			}
+		});
+
+	for (int i = 0; i < 2000; i++)
+		conversion = (i & 1) ? second : first;
+	done = true;
+	for (auto& reader : readers)
+		reader.join();
+	EXPECT_EQ(0, torn.load());
+}
+
+TEST(LowlevelTest, TestValidationTree)
+{
+	validation::validation_tree tree("Scenario", "scenario1");
+	auto fuel = tree.add_child_validation(0, "FuelMap", "fuels");
+	tree.add_child_validation(fuel, "Fuel", "C-2", validation::error_level::WARNING, "fuel.unknown", "C-22");
+	auto ignition = tree.add_child_validation(0, "Ignition", "ign1");
+	tree.add_child_validation(ignition, "Point", { "x", "y" }, validation::error_level::INFORMATION, "point.invalid", { "1", "2" });
+	tree.add_child_validation(ignition, "Time", "start", validation::error_level::SEVERE, "time.range", "25",
+		{ true, 0 }, { false, 24 }, "hours", "hour out of range");
+
+	EXPECT_EQ(6, tree.size());
+	EXPECT_EQ(validation::error_level::SEVERE, tree.max_error_level());
+	EXPECT_EQ(validation::error_level::WARNING, tree.node(fuel).max_error_level());
+
+	auto root = tree.root();
+	EXPECT_EQ("Scenario", root.protobufObject());
+	EXPECT_EQ(2, root.child_count());
+	auto point = root[1][0];
+	EXPECT_EQ("Point", point.protobufObject());
+	EXPECT_EQ(2, point.objectName().size());
+	EXPECT_EQ("y", point.objectName()[1]);
+	EXPECT_EQ("2", point.errorValue().back());
+	EXPECT_FALSE(point.units().has_value());
+
+	auto time = root[1][1];
+	ASSERT_TRUE(time.minimum().has_value());
+	EXPECT_EQ(24, std::get<std::int32_t>(time.maximum()->value));
+	EXPECT_EQ("hours", time.units().value());
+	EXPECT_EQ("hour out of range", time.errorMessage().value());
+
+	int count = 0;
+	for (auto child : root.children())
+		count += (int)child->child_count();
+	EXPECT_EQ(3, count);
+
+	size_t strings = tree.string_count();
+	EXPECT_THROW(tree.add_child_validation(0, "Fuel", ""), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "", "rejected"), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(99, "Fuel", "rejected"), std::out_of_range);
+	EXPECT_THROW(tree.add_child_validation(0, "", "rejected", validation::error_level::WARNING, "fuel.rejected", "v"), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Rejected", { "x", "" }, validation::error_level::WARNING, "fuel.rejected", { "1", "2" }), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Fuel", "x", validation::error_level::WARNING, "", "v"), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Fuel", "x", validation::error_level::WARNING, "", "v", "message"), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Fuel", "x", validation::error_level::WARNING, "", "v", { true, 0 }, { true, 1 }), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Point", { "x", "y" }, validation::error_level::WARNING, "", { "1", "2" }), std::invalid_argument);
+	EXPECT_THROW(tree.add_child_validation(0, "Point", { "x", "y" }, validation::error_level::WARNING, "point.invalid", { "1" }), std::invalid_argument);
+	// a rejected child must not be left half built in the tree, or leave its strings behind
+	EXPECT_EQ(strings, tree.string_count());
+	EXPECT_EQ(6, tree.size());
+	EXPECT_EQ(2, tree.root().child_count());
+	EXPECT_EQ("Ignition", tree.root()[1].protobufObject());
+}
+
+TEST(LowlevelTest, TestValidationTreeFromObject)
+{
+	validation::validation_object object("Scenario", "scenario1");
+	auto child = object.add_child_validation("FuelMap", "fuels").lock();
+	for (int i = 0; i < 100; i++)
+		child->add_child_validation("Fuel", "C-" + std::to_string(i % 7), validation::error_level::INFORMATION, "fuel.unused", std::to_string(i));
+	child->add_child_validation("Fuel", "O-1a", validation::error_level::WARNING, "fuel.unused", "x", "unused fuel");
+
+	validation::validation_tree tree(object);
+	EXPECT_EQ(103, tree.size());
+	EXPECT_EQ(object.max_error_level(), tree.max_error_level());
+	auto fuels = tree.root()[0];
+	EXPECT_EQ(101, fuels.child_count());
+	EXPECT_EQ("C-3", fuels[10].objectName().front());
+	EXPECT_EQ("10", fuels[10].errorValue().front());
+	EXPECT_EQ("unused fuel", fuels[100].errorMessage().value());
+	// 4 type names, 1 identifier + empty, 3 names, 7 fuel names, 100 values, 1 message
+	EXPECT_LT(tree.string_count(), 120);
+
+	// the root's own error comes across as well as its children's
+	auto time = object.add_child_validation("Time", "start", validation::error_level::SEVERE, "time.range", "25",
+		{ true, 0 }, { false, 24 }, "hours", "hour out of range").lock();
+	validation::validation_object detached(std::move(*time));
+	validation::validation_tree single(detached);
+	auto root = single.root();
+	EXPECT_EQ(1, single.size());
+	EXPECT_EQ(validation::error_level::SEVERE, root.errorLevel());
+	EXPECT_EQ("time.range", root.errorIdentifier());
+	EXPECT_EQ("25", root.errorValue().front());
+	EXPECT_EQ(24, std::get<std::int32_t>(root.maximum()->value));
+	EXPECT_EQ("hours", root.units().value());
+	EXPECT_EQ("hour out of range", root.errorMessage().value());
+}
+
+TEST(LowlevelTest, TestValidationInterning)
+{
+	validation::validation_object object("Scenario", "scenario1");
+	auto first = object.add_child_validation("Fuel", "C-1", validation::error_level::WARNING, "fuel.unknown", "1").lock();
+	auto second = object.add_child_validation("Fuel", "C-2", validation::error_level::WARNING, std::string("fuel.") + "unknown", "2").lock();
+	EXPECT_EQ("Fuel", first->protobufObject());
+	EXPECT_EQ("fuel.unknown", second->errorIdentifier());
+	EXPECT_EQ(&first->protobufObject(), &second->protobufObject());
+	EXPECT_EQ(&first->errorIdentifier(), &second->errorIdentifier());
+	EXPECT_EQ("", object.errorIdentifier());
+
+	std::vector<std::thread> threads;
+	std::atomic<int> mismatches(0);
+	for (int i = 0; i < 4; i++)
+		threads.emplace_back([&mismatches]()
+		{
+			for (int j = 0; j < 1000; j++)
+			{
+				std::string name = "intern." + std::to_string(j);
+				const std::string& interned = validation::intern_string(name);
+				if ((interned != name) || (&interned != &validation::intern_string(name)))
+					mismatches++;
+			}
+		});
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(0, mismatches.load());
+}
+
+TEST(LowlevelTest, TestValidationErrorCounts)
+{
+	validation::validation_object root("Scenario", "scenario1");
+	EXPECT_EQ(validation::error_level::NONE, root.max_error_level());
+	EXPECT_EQ(1, root.error_count(validation::error_level::NONE));
+
+	auto fuels = root.add_child_validation("FuelMap", "fuels").lock();
+	for (int i = 0; i < 10; i++)
+		fuels->add_child_validation("Fuel", "C-2", validation::error_level::INFORMATION, "fuel.unused", std::to_string(i));
+	EXPECT_EQ(validation::error_level::INFORMATION, root.max_error_level());
+	fuels->add_child_validation("Fuel", "C-3", validation::error_level::WARNING, "fuel.unknown", "x");
+	fuels->add_child_validation("Fuel", { "C-4", "C-5" }, validation::error_level::WARNING, "fuel.unknown", { "y", "z" });
+
+	auto ignitions = root.add_child_validation("Ignitions", "ignitions").lock();
+	auto ignition = ignitions->add_child_validation("Ignition", "ign1").lock();
+	EXPECT_EQ(validation::error_level::WARNING, root.max_error_level());
+	ignition->add_child_validation("Time", "start", validation::error_level::SEVERE, "time.range", "25", { true, 0 }, { false, 24 });
+
+	EXPECT_EQ(validation::error_level::SEVERE, root.max_error_level());
+	EXPECT_EQ(validation::error_level::WARNING, fuels->max_error_level());
+	EXPECT_EQ(validation::error_level::SEVERE, ignitions->max_error_level());
+	EXPECT_EQ(10, root.error_count(validation::error_level::INFORMATION));
+	EXPECT_EQ(2, root.error_count(validation::error_level::WARNING));
+	EXPECT_EQ(1, root.error_count(validation::error_level::SEVERE));
+	EXPECT_EQ(4, root.error_count(validation::error_level::NONE));
+	EXPECT_EQ(2, fuels->error_count(validation::error_level::WARNING));
+
+	// moving a tree keeps its counts, and children added afterwards still reach the new root
+	validation::validation_object moved(std::move(root));
+	EXPECT_EQ(validation::error_level::SEVERE, moved.max_error_level());
+	fuels->add_child_validation("Fuel", "D-1", validation::error_level::WARNING, "fuel.unknown", "w");
+	EXPECT_EQ(3, moved.error_count(validation::error_level::WARNING));
+
+	// a node moved out of the tree leaves behind an empty node that can still be reused
+	auto time = ignition->children().front();
+	validation::validation_object detached(std::move(*time));
+	EXPECT_EQ(validation::error_level::SEVERE, detached.max_error_level());
+	EXPECT_EQ(validation::error_level::NONE, time->errorLevel());
+	EXPECT_EQ(validation::error_level::WARNING, moved.max_error_level());
+	EXPECT_EQ(0, moved.error_count(validation::error_level::SEVERE));
+	EXPECT_EQ(5, moved.error_count(validation::error_level::NONE));
+	time->add_child_validation("Time", "end", validation::error_level::SEVERE, "time.range", "26");
+	EXPECT_EQ(1, moved.error_count(validation::error_level::SEVERE));
+	EXPECT_EQ(5, moved.error_count(validation::error_level::NONE));
+}
+
+TEST(LowlevelTest, TestValidationConcurrentCollector)
+{
+	validation::validation_object root("Scenario", "scenario1");
+	root.add_child_validation("Grid", "grid", validation::error_level::WARNING, "grid.invalid", "1");
+	{
+		validation::concurrent_collector collector(&root, 8);
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < collector.slot_count(); t++)
+			threads.emplace_back([&collector, t]()
+			{
+				auto slot = collector.slot(t);
+				auto ignition = slot->add_child_validation("Ignition", "ign" + std::to_string(t)).lock();
+				for (int i = 0; i < 100; i++)
+					ignition->add_child_validation("Point", std::to_string(i), (i == 50 && t == 3) ? validation::error_level::SEVERE : validation::error_level::INFORMATION, "point.invalid", std::to_string(t));
+			});
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	ASSERT_EQ(9, root.child_count());
+	size_t index = 0;
+	for (auto& child : root.children())
+	{
+		if (index > 0)
+		{
+			EXPECT_EQ("ign" + std::to_string(index - 1), child->objectName().front());
+			EXPECT_EQ(100, child->child_count());
+		}
+		index++;
+	}
+	EXPECT_EQ(validation::error_level::SEVERE, root.max_error_level());
+	EXPECT_EQ(799, root.error_count(validation::error_level::INFORMATION));
+	EXPECT_EQ(1, root.error_count(validation::error_level::SEVERE));
+	EXPECT_EQ(9, root.error_count(validation::error_level::NONE));
+
+	validation::concurrent_collector none(nullptr, 4);
+	EXPECT_EQ(4, none.slot_count());
+	EXPECT_EQ(nullptr, none.slot(0));
+}
+
+TEST(LowlevelTest, TestValidationSink)
+{
+	validation::counting_sink counter(validation::error_level::WARNING, true);
+	validation::validation_object root("Scenario", "scenario1");
+	root.set_sink(&counter);
+	auto fuels = root.add_child_validation("FuelMap", "fuels").lock();
+	for (int i = 0; i < 10; i++)
+		EXPECT_TRUE(fuels->add_child_validation("Fuel", "C-2", validation::error_level::INFORMATION, "fuel.unused", std::to_string(i)).expired());
+	EXPECT_FALSE(fuels->add_child_validation("Fuel", "C-3", validation::error_level::WARNING, "fuel.unknown", "x").expired());
+	EXPECT_FALSE(root.should_abort());
+	fuels->add_child_validation("Fuel", { "C-4", "C-5" }, validation::error_level::SEVERE, "fuel.unknown", { "y", "z" }, "bad fuel");
+	EXPECT_TRUE(root.should_abort());
+	EXPECT_TRUE(fuels->should_abort());
+
+	EXPECT_EQ(0, counter.count(validation::error_level::INFORMATION));
+	EXPECT_EQ(1, counter.count(validation::error_level::WARNING));
+	EXPECT_EQ(1, counter.count(validation::error_level::SEVERE));
+	EXPECT_EQ(2, fuels->child_count());
+	EXPECT_EQ(0, root.error_count(validation::error_level::INFORMATION));
+
+	std::ostringstream stream;
+	validation::stream_sink writer(stream, validation::error_level::NONE, false, false);
+	validation::validation_object other("Scenario", "scenario2");
+	other.set_sink(&writer);
+	other.add_child_validation("Fuel", { "C-4", "C-5" }, validation::error_level::SEVERE, "fuel.unknown", { "y", "z" }, "bad fuel");
+	EXPECT_EQ(0, other.child_count());
+	EXPECT_FALSE(other.should_abort());
+	EXPECT_EQ("SEVERE Fuel [C-4, C-5] fuel.unknown = y, z (bad fuel)\n", stream.str());
+
+	std::vector<std::string> seen;
+	validation::callback_sink callback([&seen](const validation::validation_event& event) { seen.emplace_back(event.values[0]); });
+	validation::validation_object third("Scenario", "scenario3");
+	third.set_sink(&callback);
+	{
+		validation::concurrent_collector collector(&third, 2);
+		collector.slot(1)->add_child_validation("Fuel", "C-1", validation::error_level::WARNING, "fuel.unknown", "1");
+		collector.slot(0)->add_child_validation("Fuel", "C-1", validation::error_level::WARNING, "fuel.unknown", "0");
+	}
+	ASSERT_EQ(2, seen.size());
+	EXPECT_EQ("1", seen[0]);
+	EXPECT_EQ(2, third.child_count());
+
+	// invalid errors are rejected before the sink sees them
+	EXPECT_THROW(third.add_child_validation("Fuel", "C-1", validation::error_level::WARNING, "", "2"), std::invalid_argument);
+	EXPECT_THROW(third.add_child_validation("Fuel", "", validation::error_level::WARNING, "fuel.unknown", "2", "message"), std::invalid_argument);
+	EXPECT_THROW(third.add_child_validation("Fuel", { "C-4", "C-5" }, validation::error_level::WARNING, "fuel.unknown", { "y" }), std::invalid_argument);
+	EXPECT_THROW(third.add_child_validation("", "C-1", validation::error_level::WARNING, "fuel.unknown", "2", { true, 0 }, { true, 1 }), std::invalid_argument);
+	EXPECT_EQ(2, seen.size());
+	EXPECT_EQ(2, third.child_count());
+}
+
+TEST(LowlevelTest, TestValidationBinary)
+{
+	validation::validation_object root("Scenario", "scenario1");
+	auto fuels = root.add_child_validation("FuelMap", "fuels").lock();
+	for (int i = 0; i < 50; i++)
+		fuels->add_child_validation("Fuel", "C-" + std::to_string(i % 5), validation::error_level::INFORMATION, "fuel.unused", std::to_string(i));
+	auto ignitions = root.add_child_validation("Ignitions", "ignitions").lock();
+	ignitions->add_child_validation("Point", { "x", "y" }, validation::error_level::WARNING, "point.invalid", { "1", "2" }, "outside the grid");
+	ignitions->add_child_validation("Time", "start", validation::error_level::SEVERE, "time.range", "25", { true, -3 }, { false, 24.5 }, "hours");
+	ignitions->add_child_validation("Name", "name", validation::error_level::WARNING, "name.range", "zz", { true, std::string("a") }, { true, std::string("m") });
+
+	auto data = validation::serialize_binary(root);
+	validation::binary_view view(data);
+	EXPECT_EQ(56, view.size());
+	EXPECT_EQ(validation::error_level::SEVERE, view.max_error_level());
+
+	auto r = view.root();
+	EXPECT_EQ("Scenario", r.protobufObject());
+	EXPECT_EQ("scenario1", r.objectName().front());
+	ASSERT_EQ(2, r.child_count());
+	EXPECT_EQ(validation::error_level::INFORMATION, r[0].max_error_level());
+	EXPECT_EQ(50, r[0].child_count());
+	EXPECT_EQ("C-2", r[0][12].objectName().front());
+	EXPECT_EQ("12", r[0][12].errorValue().front());
+	EXPECT_EQ("fuel.unused", r[0][12].errorIdentifier());
+	EXPECT_FALSE(r[0][12].units().has_value());
+
+	auto point = r[1][0];
+	EXPECT_EQ("y", point.objectName()[1]);
+	EXPECT_EQ("2", point.errorValue()[1]);
+	EXPECT_EQ("outside the grid", point.errorMessage().value());
+
+	auto time = r[1][1];
+	EXPECT_EQ(validation::error_level::SEVERE, time.errorLevel());
+	EXPECT_EQ(-3, std::get<std::int32_t>(time.minimum()->value));
+	EXPECT_TRUE(time.minimum()->is_inclusive);
+	EXPECT_EQ(24.5, std::get<double>(time.maximum()->value));
+	EXPECT_FALSE(time.maximum()->is_inclusive);
+	EXPECT_EQ("hours", time.units().value());
+	EXPECT_EQ("m", std::get<std::string_view>(r[1][2].maximum()->value));
+
+	size_t count = 0;
+	for (auto child : r.children())
+		count += child->child_count();
+	EXPECT_EQ(53, count);
+
+	// the flat tree encodes to the same bytes
+	validation::validation_tree tree(root);
+	EXPECT_EQ(data, validation::serialize_binary(tree));
+
+	// repeated type names, identifiers and object names are only written once
+	EXPECT_LT(data.size(), 1000);
+
+	for (size_t length = 0; length < data.size(); length += 7)
+		EXPECT_THROW(validation::binary_view(data.data(), length), std::invalid_argument);
+}
+
+TEST(LowlevelTest, TestValidationIndexedChildren)
+{
+	validation::validation_object root("Scenario", "scenario1");
+	for (int i = 0; i < 1000; i++)
+		root.add_child_validation("Fuel", "C-" + std::to_string(i), validation::error_level::INFORMATION, "fuel.unused", std::to_string(i));
+
+	const validation::validation_object& croot = root;
+	for (size_t i = 0; i < root.child_count(); i++)
+	{
+		EXPECT_EQ(std::to_string(i), croot.child(i)->errorValue().front());
+		EXPECT_EQ(root.child(i), root[(std::uint32_t)i].lock().get());
+	}
+	EXPECT_EQ(root.child(999), root.children().back().get());
+}
+
+TEST(LowlevelTest, TestEvents)
+{
+	neosmart::neosmart_event_t manual = neosmart::CreateEvent(true, false);
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(manual, 0));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(manual, 10));
+	neosmart::SetEvent(manual);
+	EXPECT_EQ(0, neosmart::WaitForEvent(manual, 0));
+	EXPECT_EQ(0, neosmart::WaitForEvent(manual));
+	neosmart::ResetEvent(manual);
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(manual, 0));
+
+	neosmart::neosmart_event_t automatic = neosmart::CreateEvent(false, true);
+	EXPECT_EQ(0, neosmart::WaitForEvent(automatic, 0));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(automatic, 0));
+
+	//a manual-reset event releases every waiter
+	std::atomic<int> released{ 0 };
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; i++)
+		threads.emplace_back([&]() { if (neosmart::WaitForEvent(manual) == 0) released++; });
+	neosmart::SetEvent(manual);
+	for (auto& t : threads)
+		t.join();
+	EXPECT_EQ(4, released.load());
+
+	//an auto-reset event releases one waiter per signal
+	const int rounds = 10000;
+	std::atomic<int> consumed{ 0 };
+	std::thread consumer([&]()
+		{
+			for (int i = 0; i < rounds; i++)
+			{
+				neosmart::WaitForEvent(automatic);
+				consumed++;
+				neosmart::SetEvent(manual);
+			}
+		});
+	for (int i = 0; i < rounds; i++)
+	{
+		neosmart::ResetEvent(manual);
+		neosmart::SetEvent(automatic);
+		while (consumed.load() <= i)
+			neosmart::WaitForEvent(manual, 100);
+	}
+	consumer.join();
+	EXPECT_EQ(rounds, consumed.load());
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(automatic, 0));
+
+	neosmart::DestroyEvent(manual);
+	neosmart::DestroyEvent(automatic);
+}
+
+TEST(LowlevelTest, TestEventTimeouts)
+{
+	neosmart::neosmart_event_t event = neosmart::CreateEvent(true, false);
+
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(event, std::chrono::microseconds(1500)));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(1500));
+
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(event, std::chrono::nanoseconds(0)));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(event, std::chrono::nanoseconds(-5)));
+
+	std::thread setter([event]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			neosmart::SetEvent(event);
+		});
+	EXPECT_EQ(0, neosmart::WaitForEvent(event, std::chrono::nanoseconds::max()));
+	setter.join();
+	EXPECT_EQ(0, neosmart::WaitForEvent(event, std::chrono::nanoseconds(1)));
+	//a millisecond timeout too large to hold in nanoseconds
+	EXPECT_EQ(0, neosmart::WaitForEvent(event, UINT64_MAX / 1000));
+
+	neosmart::DestroyEvent(event);
+}
+
+TEST(LowlevelTest, TestEventAdaptiveWait)
+{
+	neosmart::neosmart_event_attr_t attributes;
+	attributes.SpinCount = 1 << 20;
+	attributes.YieldCount = 1000;
+	neosmart::neosmart_event_t ping = neosmart::CreateEvent(attributes);
+	neosmart::neosmart_event_t pong = neosmart::CreateEvent(attributes);
+
+	const int rounds = 2000;
+	std::thread other([&]()
+		{
+			for (int i = 0; i < rounds; i++)
+			{
+				EXPECT_EQ(0, neosmart::WaitForEvent(ping));
+				neosmart::SetEvent(pong);
+			}
+		});
+	for (int i = 0; i < rounds; i++)
+	{
+		neosmart::SetEvent(ping);
+		EXPECT_EQ(0, neosmart::WaitForEvent(pong));
+	}
+	other.join();
+
+	neosmart::neosmart_event_stats_t stats;
+	EXPECT_EQ(0, neosmart::GetEventWaitStats(ping, stats));
+	EXPECT_LE(stats.Spins + stats.Yields + stats.Blocks, (std::uint64_t)rounds);
+
+	//spinning still honours the timeout
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(ping, std::chrono::microseconds(500)));
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	EXPECT_GE(elapsed, std::chrono::microseconds(500));
+	EXPECT_LT(elapsed, std::chrono::seconds(1));
+
+	neosmart::neosmart_event_t plain = neosmart::CreateEvent(false, false);
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(plain, 1));
+	EXPECT_EQ(0, neosmart::GetEventWaitStats(plain, stats));
+	EXPECT_EQ(0u, stats.Spins + stats.Yields);
+	EXPECT_EQ(1u, stats.Blocks);
+
+	neosmart::DestroyEvent(ping);
+	neosmart::DestroyEvent(pong);
+	neosmart::DestroyEvent(plain);
+}
+
+#ifdef __linux__
+TEST(LowlevelTest, TestEventPollFd)
+{
+	neosmart::neosmart_event_t event = neosmart::CreateEvent(false, true);
+	int fd = neosmart::GetEventPollFd(event);
+	ASSERT_NE(-1, fd);
+	EXPECT_EQ(fd, neosmart::GetEventPollFd(event));
+
+	auto readable = [fd](int timeout)
+	{
+		pollfd p = { fd, POLLIN, 0 };
+		return poll(&p, 1, timeout) == 1 && (p.revents & POLLIN);
+	};
+
+	//the descriptor picks up the state the event already had
+	EXPECT_TRUE(readable(0));
+	EXPECT_EQ(0, neosmart::WaitForEvent(event, 0));
+	EXPECT_FALSE(readable(0));
+	neosmart::SetEvent(event);
+	neosmart::SetEvent(event);
+	EXPECT_TRUE(readable(0));
+	neosmart::ResetEvent(event);
+	EXPECT_FALSE(readable(0));
+
+	//wait on the event alongside other descriptors with epoll
+	int epoll = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event registration = {};
+	registration.events = EPOLLIN;
+	registration.data.fd = fd;
+	ASSERT_EQ(0, epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &registration));
+	std::thread setter([event]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			neosmart::SetEvent(event);
+		});
+	epoll_event ready;
+	EXPECT_EQ(1, epoll_wait(epoll, &ready, 1, 5000));
+	EXPECT_EQ(fd, ready.data.fd);
+	setter.join();
+	EXPECT_EQ(0, neosmart::WaitForEvent(event, 0));
+	EXPECT_EQ(0, epoll_wait(epoll, &ready, 1, 0));
+	close(epoll);
+
+	neosmart::DestroyEvent(event);
+}
+#endif
+
+#ifdef PEVENTS_INSTRUMENTATION
+TEST(LowlevelTest, TestEventInstrumentation)
+{
+	neosmart::neosmart_event_t event = neosmart::CreateEvent(false, false, "instrumented");
+	neosmart::neosmart_event_info_t info;
+	EXPECT_EQ(0, neosmart::GetEventInfo(event, info));
+	EXPECT_EQ("instrumented", info.Name);
+	EXPECT_FALSE(info.ManualReset);
+	EXPECT_FALSE(info.Signaled);
+	EXPECT_EQ(0u, info.Waits);
+
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(event, 2));
+	neosmart::SetEvent(event);
+	EXPECT_EQ(0, neosmart::GetEventInfo(event, info));
+	EXPECT_TRUE(info.Signaled);
+	EXPECT_EQ(0, neosmart::WaitForEvent(event));
+
+	std::thread waiter([event]() { EXPECT_EQ(0, neosmart::WaitForEvent(event)); });
+	while (neosmart::GetEventInfo(event, info) == 0 && info.Waiters == 0)
+		std::this_thread::yield();
+	neosmart::SetEvent(event);
+	waiter.join();
+
+	EXPECT_EQ(0, neosmart::GetEventInfo(event, info));
+	EXPECT_EQ(2u, info.Sets);
+	EXPECT_EQ(3u, info.Waits);
+	EXPECT_EQ(1u, info.Timeouts);
+	EXPECT_EQ(0u, info.Waiters);
+	EXPECT_EQ(1u, info.PeakWaiters);
+	EXPECT_GE(info.MaxWaitNanoseconds, 2000000u);
+	std::uint64_t histogram = 0;
+	for (int i = 0; i < neosmart::EventWaitHistogramBuckets; i++)
+		histogram += info.WaitHistogram[i];
+	EXPECT_EQ(info.Waits, histogram);
+
+	//the dump lists every live event by name
+	char *buffer = nullptr;
+	size_t size = 0;
+	FILE *out = open_memstream(&buffer, &size);
+	neosmart::DumpEvents(out);
+	fclose(out);
+	EXPECT_NE(nullptr, strstr(buffer, "instrumented"));
+	free(buffer);
+
+	neosmart::DestroyEvent(event);
+	out = open_memstream(&buffer, &size);
+	neosmart::DumpEvents(out);
+	fclose(out);
+	EXPECT_EQ(nullptr, strstr(buffer, "instrumented"));
+	free(buffer);
+}
+#endif
+
+TEST(LowlevelTest, TestThreadPool)
+{
+	hss::thread_pool_options options;
+	options.thread_count = 4;
+	hss::thread_pool pool(options);
+	EXPECT_EQ(4u, pool.thread_count());
+	EXPECT_EQ(-1, pool.current_worker());
+
+	std::vector<hss::task_future<int>> futures;
+	for (int i = 0; i < 1000; i++)
+		futures.push_back(pool.submit([i]() { return i * 2; }, i % 2 ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_LOWEST));
+	int sum = 0;
+	for (auto& future : futures)
+		sum += future.get();
+	EXPECT_EQ(999 * 1000, sum);
+
+	//tasks submitted from a worker go to its own queue and can be stolen by the others
+	std::atomic<int> leaves{ 0 };
+	auto root = pool.submit([&]()
+		{
+			EXPECT_NE(-1, pool.current_worker());
+			std::vector<hss::task_future<void>> children;
+			for (int i = 0; i < 100; i++)
+				children.push_back(pool.submit([&leaves]() { leaves++; }));
+			for (auto& child : children)
+				child.wait();
+		});
+	root.get();
+	EXPECT_EQ(100, leaves.load());
+
+	auto failed = pool.submit([]() -> int { throw std::runtime_error("failed"); });
+	EXPECT_THROW(failed.get(), std::runtime_error);
+
+	//a future's event can be waited on like any other
+	neosmart::neosmart_event_t gate = neosmart::CreateEvent(true, false);
+	auto gated = pool.submit([gate]() { neosmart::WaitForEvent(gate); });
+	EXPECT_FALSE(gated.ready());
+	EXPECT_FALSE(gated.wait_for(std::chrono::milliseconds(1)));
+	neosmart::SetEvent(gate);
+	EXPECT_EQ(0, neosmart::WaitForEvent(gated.event(), std::chrono::seconds(5)));
+	EXPECT_TRUE(gated.ready());
+	neosmart::DestroyEvent(gate);
+}
+
+TEST(LowlevelTest, TestThreadPoolDrainsOnDestruction)
+{
+	std::atomic<int> ran{ 0 };
+	{
+		hss::thread_pool_options options;
+		options.thread_count = 2;
+		options.pin_threads = true;
+		hss::thread_pool pool(options);
+		for (int i = 0; i < 500; i++)
+			pool.submit([&ran]() { ran++; });
+	}
+	EXPECT_EQ(500, ran.load());
+}
+
+TEST(LowlevelTest, TestIniSettingsWriteBehind)
+{
+	fs::path path = fs::temp_directory_path() / ("lowlevel_settings_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".info");
+	{
+		IniSettings settings(path.string(), true);
+		settings.SetWriteBehind(std::chrono::hours(1));
+		for (int i = 0; i < 200; i++)
+			settings.WriteProfileInt("startup", "key" + std::to_string(i), i);
+		settings.WriteProfileString("startup", "name", "value");
+		//nothing is written until the delay passes
+		EXPECT_FALSE(fs::exists(path));
+		EXPECT_EQ(199, settings.GetProfileInt("startup", "key199", -1));
+
+		settings.Flush();
+		ASSERT_TRUE(fs::exists(path));
+		//the temporary file was renamed over the settings
+		for (auto &entry : fs::directory_iterator(path.parent_path()))
+		{
+			std::string name = entry.path().filename().string();
+			EXPECT_FALSE(name.rfind(path.filename().string() + ".", 0) == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) << name;
+		}
+
+		//a short delay saves from the background thread
+		settings.SetWriteBehind(std::chrono::milliseconds(10));
+		settings.WriteProfileDouble("startup", "ratio", 0.5, "");
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (IniSettings(path.string(), false).GetProfileDouble("startup", "ratio", 0.0) != 0.5 && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		EXPECT_EQ(0.5, IniSettings(path.string(), false).GetProfileDouble("startup", "ratio", 0.0));
+
+		//concurrent writers and readers, the rest is saved on destruction
+		settings.SetWriteBehind(std::chrono::hours(1));
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++)
+		{
+			threads.emplace_back([&settings, t]()
+				{
+					for (int i = 0; i < 100; i++)
+					{
+						settings.WriteProfileInt("thread" + std::to_string(t), "key" + std::to_string(i), i);
+						EXPECT_EQ(i, settings.GetProfileInt("thread" + std::to_string(t), "key" + std::to_string(i), -1));
+					}
+				});
+		}
+		for (auto &thread : threads)
+			thread.join();
+	}
+
+	IniSettings reloaded(path.string(), false);
+	EXPECT_EQ(150, reloaded.GetProfileInt("startup", "key150", -1));
+	EXPECT_EQ("value", reloaded.GetProfileString("startup", "name", ""));
+	for (int t = 0; t < 4; t++)
+		EXPECT_EQ(99, reloaded.GetProfileInt("thread" + std::to_string(t), "key99", -1));
+	fs::remove(path);
+
+	//a save that fails leaves the settings dirty, so the next flush tries again
+	fs::path directory = path.string() + ".dir";
+	fs::path nested = directory / "settings.info";
+	{
+		IniSettings settings(nested.string(), false);
+		settings.WriteProfileInt("startup", "retry", 7);
+		settings.Flush();
+		EXPECT_FALSE(fs::exists(nested));
+		fs::create_directory(directory);
+		settings.Flush();
+		EXPECT_TRUE(fs::exists(nested));
+	}
+	EXPECT_EQ(7, IniSettings(nested.string(), false).GetProfileInt("startup", "retry", -1));
+	fs::remove_all(directory);
+}
+
+TEST(LowlevelTest, TestIniSettingsReadCache)
+{
+	fs::path path = fs::temp_directory_path() / ("lowlevel_settings_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".info");
+	IniSettings settings(path.string(), false);
+	settings.WriteProfileInt("group", "int", -5);
+	settings.WriteProfileDouble("group", "double", 2.5, "");
+	settings.WriteProfileString("group", "text", "not a number");
+	settings.WriteProfileBOOL("group", "flag", true);
+	settings.WriteProfileLongLong("group", "big", 1ull << 40);
+	settings.WriteRegistryInt("group", "int", 7);
+
+	EXPECT_EQ(-5, settings.GetProfileInt("group", "int", 0));
+	EXPECT_EQ(-5.0, settings.GetProfileDouble("group", "int", 0.0));
+	EXPECT_EQ(2.5, settings.GetProfileDouble("group", "double", 0.0));
+	EXPECT_EQ(1ull << 40, settings.GetProfileLongLong("group", "big", 0));
+	EXPECT_TRUE(settings.GetProfileBOOL("group", "flag", false));
+	EXPECT_EQ(7, settings.GetRegistryInt("group", "int", 0));
+	//values that don't parse as the requested type, and missing ones, give the default
+	EXPECT_EQ(3, settings.GetProfileInt("group", "text", 3));
+	EXPECT_EQ(3, settings.GetProfileInt("group", "double", 3));
+	EXPECT_EQ(3, settings.GetProfileInt("group", "missing", 3));
+	EXPECT_EQ("none", settings.GetProfileString("other", "int", "none"));
+	EXPECT_EQ("not a number", settings.GetProfileString("group", "text", ""));
+
+	//writes are seen by the next read
+	settings.WriteProfileInt("group", "int", 12);
+	EXPECT_EQ(12, settings.GetProfileInt("group", "int", 0));
+	//including the groups a write adds on the way to the value
+	settings.WriteProfileInt("new|nested", "value", 3);
+	EXPECT_EQ(3, settings.GetProfileInt("new|nested", "value", 0));
+	EXPECT_EQ("", settings.GetProfileString("new", "nested", "none"));
+
+	//writes while another thread holds the snapshot go beside it, and are folded in once there are many
+	std::thread([&settings]() { EXPECT_EQ(12, settings.GetProfileInt("group", "int", 0)); }).join();
+	std::atomic<int> step{ 0 };
+	std::thread holder([&settings, &step]()
+		{
+			EXPECT_EQ(12, settings.GetProfileInt("group", "int", 0));
+			step.store(1);
+			while (step.load() != 2)
+				std::this_thread::yield();
+			EXPECT_EQ(199, settings.GetProfileInt("many", "199", 0));
+		});
+	while (step.load() != 1)
+		std::this_thread::yield();
+	for (int i = 0; i < 200; i++)
+	{
+		settings.WriteProfileInt("many", std::to_string(i), i);
+		settings.WriteProfileInt("group", "int", 100 + i);
+		EXPECT_EQ(i, settings.GetProfileInt("many", std::to_string(i), -1));
+		EXPECT_EQ(100 + i, settings.GetProfileInt("group", "int", 0));
+	}
+	step.store(2);
+	holder.join();
+	for (int i = 0; i < 200; i++)
+		EXPECT_EQ(i, settings.GetProfileInt("many", std::to_string(i), -1));
+	EXPECT_EQ(2.5, settings.GetProfileDouble("group", "double", 0.0));
+
+	//readers on other threads pick up writes without locking on every read
+	std::atomic<bool> done{ false };
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 3; t++)
+	{
+		readers.emplace_back([&settings, &done]()
+			{
+				int last = 0;
+				while (!done.load())
+				{
+					int value = settings.GetProfileInt("counter", "value", 0);
+					EXPECT_GE(value, last);
+					last = value;
+				}
+				EXPECT_EQ(1000, settings.GetProfileInt("counter", "value", 0));
+			});
+	}
+	for (int i = 1; i <= 1000; i++)
+		settings.WriteProfileInt("counter", "value", i);
+	done.store(true);
+	for (auto &reader : readers)
+		reader.join();
+}
+
+TEST(LowlevelTest, TestIniSettingsLazy)
+{
+	fs::path path = fs::temp_directory_path() / ("lowlevel_settings_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".info");
+	{
+		std::ofstream out(path.string());
+		out << "; settings\n"
+			"first\n"
+			"{\n"
+			"    value 1\n"
+			"    text \"has { braces } and \\\" quotes\"\n"
+			"}\n"
+			"\"quoted group\" { value 2 } second { value 3\n"
+			"    nested { deeper \"a \" \\\n"
+			"        \"continued\" }\n"
+			"}\n"
+			"registry\n"
+			"{\n"
+			"    tool { value 4 }\n"
+			"}\n"
+			"first { value 5 }\n";
+	}
+
+	IniSettings lazy(path.string(), false, true);
+	IniSettings eager(path.string(), false, false);
+	EXPECT_EQ(eager.GetProfileInt("first", "value", 0), lazy.GetProfileInt("first", "value", 0));
+	EXPECT_EQ(1, lazy.GetProfileInt("first", "value", 0));
+	EXPECT_EQ("has { braces } and \" quotes", lazy.GetProfileString("first", "text", ""));
+	EXPECT_EQ(2, lazy.GetProfileInt("quoted group", "value", 0));
+	EXPECT_EQ(3, lazy.GetProfileInt("second", "value", 0));
+	EXPECT_EQ(eager.GetProfileString("second|nested", "deeper", "x"), lazy.GetProfileString("second|nested", "deeper", ""));
+	EXPECT_EQ("a continued", lazy.GetProfileString("second|nested", "deeper", ""));
+	EXPECT_EQ(4, lazy.GetRegistryInt("tool", "value", 0));
+	EXPECT_EQ(-1, lazy.GetProfileInt("missing", "value", -1));
+
+	//a write to a group that hasn't been read yet keeps the rest of the group
+	IniSettings writer(path.string(), false, true);
+	writer.WriteProfileInt("second", "added", 6);
+	EXPECT_EQ(3, writer.GetProfileInt("second", "value", 0));
+	writer.Save();
+
+	IniSettings reloaded(path.string(), false, true);
+	EXPECT_EQ(1, reloaded.GetProfileInt("first", "value", 0));
+	EXPECT_EQ(6, reloaded.GetProfileInt("second", "added", 0));
+	EXPECT_EQ("a continued", reloaded.GetProfileString("second|nested", "deeper", ""));
+	EXPECT_EQ(4, reloaded.GetRegistryInt("tool", "value", 0));
+	EXPECT_EQ(2, reloaded.GetProfileInt("quoted group", "value", 0));
+
+	//an older build truncating the file in place doesn't take the unparsed groups with it
+	IniSettings truncated(path.string(), false, true);
+	std::ofstream(path.string(), std::ios::trunc).close();
+	EXPECT_EQ(6, truncated.GetProfileInt("second", "added", 0));
+	EXPECT_EQ(4, truncated.GetRegistryInt("tool", "value", 0));
+	fs::remove(path);
+}
+
+TEST(LowlevelTest, TestIniSettingsBlobs)
+{
+	fs::path path = fs::temp_directory_path() / ("lowlevel_settings_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".info");
+	std::vector<std::uint8_t> colours(100000);
+	for (size_t i = 0; i < colours.size(); i++)
+		colours[i] = (std::uint8_t)(i * 31);
+	std::vector<std::uint8_t> layout = { 0, 1, 2, 0, 255 };
+	{
+		IniSettings settings(path.string(), false);
+		settings.WriteProfileBlob("cache", "colours", colours.data(), (std::uint32_t)colours.size());
+		IniSettings::BlobView view = settings.GetProfileBlob("cache", "colours");
+		ASSERT_EQ(colours.size(), view.size);
+		EXPECT_TRUE(std::equal(view.begin(), view.end(), colours.begin()));
+
+		//identical blobs are stored once
+		auto size = fs::file_size(path.string() + ".blobs");
+		settings.WriteProfileBlob("cache", "copy", colours.data(), (std::uint32_t)colours.size());
+		EXPECT_EQ(size, fs::file_size(path.string() + ".blobs"));
+
+		//views stay valid after more blobs are added
+		settings.WriteProfileBlob("cache", "layout", layout.data(), (std::uint32_t)layout.size());
+		EXPECT_TRUE(std::equal(view.begin(), view.end(), colours.begin()));
+
+		std::uint8_t *data = nullptr;
+		std::uint32_t len = 0;
+		settings.GetProfileBinary("cache", "layout", &data, &len);
+		ASSERT_EQ(layout.size(), len);
+		EXPECT_TRUE(std::equal(data, data + len, layout.begin()));
+		delete[] data;
+
+		//values written the old way aren't blobs
+		settings.WriteProfileBinary("cache", "inline", layout.data(), (std::uint32_t)layout.size());
+		EXPECT_TRUE(settings.GetProfileBlob("cache", "inline").empty());
+		EXPECT_TRUE(settings.GetProfileBlob("cache", "missing").empty());
+
+#ifdef __linux__
+		//appends only map what's new, growing the store a blob at a time doesn't pile up mappings
+		std::vector<std::uint8_t> chunk(65536);
+		for (std::uint32_t i = 0; i < 200; i++)
+		{
+			std::memcpy(chunk.data(), &i, sizeof(i));
+			settings.WriteProfileBlob("chunks", std::to_string(i), chunk.data(), (std::uint32_t)chunk.size());
+		}
+		EXPECT_TRUE(std::equal(view.begin(), view.end(), colours.begin()));
+		std::ifstream maps("/proc/self/maps");
+		std::string line, blobs = path.string() + ".blobs";
+		size_t mappings = 0;
+		while (std::getline(maps, line))
+		{
+			if (line.find(blobs) != std::string::npos)
+				mappings++;
+		}
+		EXPECT_GE(mappings, 1u);
+		EXPECT_LE(mappings, 4u);
+#endif
+		settings.Save();
+	}
+
+	IniSettings reloaded(path.string(), false, true);
+	IniSettings::BlobView view = reloaded.GetProfileBlob("cache", "copy");
+	ASSERT_EQ(colours.size(), view.size);
+	EXPECT_TRUE(std::equal(view.begin(), view.end(), colours.begin()));
+	view = reloaded.GetProfileBlob("cache", "layout");
+	EXPECT_TRUE(std::equal(view.begin(), view.end(), layout.begin(), layout.end()));
+	fs::remove(path);
+	fs::remove(path.string() + ".blobs");
+}
+
+TEST(LowlevelTest, TestIniSettingsBlobsShared)
+{
+	fs::path path = fs::temp_directory_path() / ("lowlevel_settings_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".info");
+	std::string blobs = path.string() + ".blobs";
+
+	//separate instances have their own handles on the store, the same as separate processes
+	IniSettings first(path.string(), false), second(path.string(), false);
+	auto write = [](IniSettings* settings, std::uint32_t writer) {
+		std::vector<std::uint8_t> data(4096 + writer * 8);
+		for (std::uint32_t i = 0; i < 50; i++)
+		{
+			data[0] = (std::uint8_t)writer;
+			std::memcpy(data.data() + 1, &i, sizeof(i));
+			settings->WriteProfileBlob("writer" + std::to_string(writer), std::to_string(i), data.data(), (std::uint32_t)data.size());
+		}
+	};
+	std::thread a(write, &first, 1), b(write, &second, 2);
+	a.join();
+	b.join();
+
+	auto check = [](IniSettings& settings, IniSettings& written, std::uint32_t writer) {
+		for (std::uint32_t i = 0; i < 50; i++)
+		{
+			std::string group = "writer" + std::to_string(writer), key = std::to_string(i);
+			//the reference is in the tree of the instance that wrote it, the bytes are in the shared store
+			settings.WriteProfileString(group, key, written.GetProfileString(group, key, ""));
+			IniSettings::BlobView view = settings.GetProfileBlob(group, key);
+			ASSERT_EQ(4096 + writer * 8, view.size);
+			std::uint32_t index;
+			std::memcpy(&index, view.data + 1, sizeof(index));
+			EXPECT_EQ(writer, view.data[0]);
+			EXPECT_EQ(i, index);
+		}
+	};
+	{
+		IniSettings reader(path.string(), false);
+		check(reader, first, 1);
+		check(reader, second, 2);
+	}
+
+	//a record a writer didn't finish is dropped by the next one to take the lock
+	auto size = fs::file_size(blobs);
+	{
+		std::ofstream out(blobs, std::ios::binary | std::ios::app);
+		out.write("\x01\x02\x03\x04\x05\x06\x07\x08\xff\x00\x00\x00", 12);
+	}
+	std::uint8_t late[3] = { 7, 8, 9 };
+	{
+		IniSettings writer(path.string(), false);
+		writer.WriteProfileBlob("late", "value", late, sizeof(late));
+		EXPECT_EQ(size + 24, fs::file_size(blobs));
+		IniSettings::BlobView view = writer.GetProfileBlob("late", "value");
+		ASSERT_EQ(3u, view.size);
+		EXPECT_TRUE(std::equal(view.begin(), view.end(), late));
+	}
+	fs::remove(path);
+	fs::remove(blobs);
+}
+
+TEST(LowlevelTest, TestNumericVariantConversions)
+{
+	std::int32_t i32;
+	EXPECT_TRUE(variantToInt32(NumericVariant(true), &i32));
+	EXPECT_EQ(1, i32);
+	EXPECT_TRUE(variantToInt32(NumericVariant((std::int8_t)-3), &i32));
+	EXPECT_EQ(-3, i32);
+	EXPECT_TRUE(variantToInt32(NumericVariant((std::uint64_t)0x100000005ull), &i32));
+	EXPECT_EQ(5, i32);
+	EXPECT_TRUE(variantToInt32(NumericVariant(2.5), &i32));
+	EXPECT_EQ(3, i32);
+	EXPECT_TRUE(variantToInt32(NumericVariant(2.4f), &i32));
+	EXPECT_EQ(2, i32);
+	EXPECT_FALSE(variantToInt32(NumericVariant(), &i32));
+	EXPECT_EQ(0, i32);
+
+	std::uint8_t u8;
+	EXPECT_TRUE(variantToUInt8(NumericVariant((std::int16_t)300), &u8));
+	EXPECT_EQ(44, u8);
+
+	bool b;
+	EXPECT_TRUE(variantToBoolean(NumericVariant((std::uint16_t)2), &b));
+	EXPECT_TRUE(b);
+	EXPECT_TRUE(variantToBoolean(NumericVariant((std::int64_t)0), &b));
+	EXPECT_FALSE(b);
+	EXPECT_FALSE(variantToBoolean(NumericVariant(1.0), &b));
+	EXPECT_FALSE(variantToBoolean(NumericVariant(), &b));
+
+	double d;
+	EXPECT_TRUE(variantToDouble(NumericVariant(1.5f), &d));
+	EXPECT_EQ(1.5, d);
+	EXPECT_TRUE(variantToDouble(NumericVariant((std::uint32_t)4000000000u), &d));
+	EXPECT_EQ(4000000000.0, d);
+	EXPECT_FALSE(variantToDouble(NumericVariant(true), &d));
+	EXPECT_EQ(0.0, d);
+
+	float f;
+	EXPECT_TRUE(variantToFloat(NumericVariant(-0.25), &f));
+	EXPECT_EQ(-0.25f, f);
+	EXPECT_FALSE(variantToFloat(NumericVariant(false), &f));
+
+	//the template and the named functions agree for every alternative
+	std::vector<NumericVariant> values = { NumericVariant(), true, (std::int8_t)-100, (std::int16_t)-30000, (std::int32_t)123456789,
+		(std::int64_t)-5000000000ll, (std::uint8_t)250, (std::uint16_t)65000, (std::uint32_t)3000000000u, (std::uint64_t)1ull << 50, 7.75f, -1234.5 };
+	for (auto &value : values)
+	{
+		std::int64_t a, b;
+		EXPECT_EQ(variantToInt64(value, &a), variantTo(value, &b));
+		EXPECT_EQ(a, b);
+		std::uint16_t c, e;
+		EXPECT_EQ(variantToUInt16(value, &c), variantTo(value, &e));
+		EXPECT_EQ(c, e);
+	}
+}
+
+TEST(LowlevelTest, TestNumericColumn)
+{
+	//enough values for the 4 wide SSE2 loops and a scalar tail, around the rounding and sign extension edges
+	const double seeds[] = { -70000.5, -129, -128.5, -1, -0.5, 0, 0.49, 1, 2.5, 127, 128, 255.5, 40000, 65535, 2000000001.5 };
+	auto make = [](size_t index, double seed) -> NumericVariant {
+		switch (index) {
+		case 1:		return seed != 0;
+		case 2:		return (std::int8_t)(std::int64_t)seed;
+		case 3:		return (std::int16_t)(std::int64_t)seed;
+		case 4:		return (std::int32_t)(std::int64_t)seed;
+		case 5:		return (std::int64_t)seed;
+		case 6:		return (std::uint8_t)(std::int64_t)seed;
+		case 7:		return (std::uint16_t)(std::int64_t)seed;
+		case 8:		return (std::uint32_t)(std::int64_t)seed;
+		case 9:		return (std::uint64_t)(std::int64_t)seed;
+		case 10:	return (float)seed;
+		case 11:	return seed;
+		default:	return NumericVariant();
+		}
+	};
+	auto check = [](const std::vector<NumericVariant>& values, const NumericColumn& column) {
+		size_t count = values.size();
+		std::vector<double> d(count);
+		std::vector<float> f(count);
+		std::vector<std::int32_t> i32(count);
+		std::vector<std::int64_t> i64(count);
+		bool dOk = true, fOk = true, i32Ok = true, i64Ok = true;
+		EXPECT_EQ(count, column.size());
+		for (size_t i = 0; i < count; i++)
+			EXPECT_EQ(values[i], column[i]);
+		//from an offset so the SIMD loads are unaligned and the tail length changes
+		size_t first = count > 1 ? 1 : 0;
+		bool dBulk = column.toDouble(d.data(), first, count - first);
+		bool fBulk = column.toFloat(f.data(), first, count - first);
+		bool i32Bulk = column.toInt32(i32.data(), first, count - first);
+		bool i64Bulk = column.toInt64(i64.data(), first, count - first);
+		for (size_t i = first; i < count; i++)
+		{
+			double dv; float fv; std::int32_t i32v; std::int64_t i64v;
+			dOk &= variantTo(values[i], &dv);
+			fOk &= variantTo(values[i], &fv);
+			i32Ok &= variantTo(values[i], &i32v);
+			i64Ok &= variantTo(values[i], &i64v);
+			EXPECT_EQ(dv, d[i - first]);
+			EXPECT_EQ(fv, f[i - first]);
+			EXPECT_EQ(i32v, i32[i - first]);
+			EXPECT_EQ(i64v, i64[i - first]);
+		}
+		EXPECT_EQ(dOk, dBulk);
+		EXPECT_EQ(fOk, fBulk);
+		EXPECT_EQ(i32Ok, i32Bulk);
+		EXPECT_EQ(i64Ok, i64Bulk);
+	};
+
+	for (size_t index = 1; index < std::variant_size_v<NumericVariant>; index++)
+	{
+		std::vector<NumericVariant> values;
+		for (double seed : seeds)
+			values.push_back(make(index, seed));
+		NumericColumn column(values);
+		EXPECT_EQ(index, column.type());
+		check(values, column);
+	}
+
+	//a column of one type is packed, 15 int16 values take 30 bytes
+	std::vector<NumericVariant> shorts;
+	for (double seed : seeds)
+		shorts.push_back(make(3, seed));
+	NumericColumn packed(shorts);
+	EXPECT_EQ(sizeof(seeds) / sizeof(seeds[0]) * 2, packed.memoryUsage());
+
+	//a value of another type moves the column to the tagged layout
+	NumericColumn grown;
+	std::vector<NumericVariant> mixed;
+	for (size_t i = 0; i < 40; i++)
+	{
+		mixed.push_back(make(i < 20 ? 11 : 1 + i % 11, seeds[i % (sizeof(seeds) / sizeof(seeds[0]))]));
+		grown.push_back(mixed.back());
+		EXPECT_EQ(i < 20 ? 11 : NumericColumn::mixed, grown.type());
+	}
+	check(mixed, grown);
+	check(mixed, NumericColumn(mixed));
+	mixed.push_back(NumericVariant());
+	grown.push_back(NumericVariant());
+	check(mixed, grown);
+
+	double out[2];
+	EXPECT_FALSE(grown.toDouble(out, grown.size() - 1, 2));
+	grown.clear();
+	EXPECT_TRUE(grown.empty());
+	EXPECT_EQ(0u, grown.type());
+}
+}
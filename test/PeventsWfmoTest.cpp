@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "pevents.h"
+
+
+namespace
+{
+std::vector<neosmart::neosmart_event_t> createEvents(int count, bool manualReset)
+{
+	std::vector<neosmart::neosmart_event_t> events;
+	for (int i = 0; i < count; i++)
+		events.push_back(neosmart::CreateEvent(manualReset, false));
+	return events;
+}
+
+void destroyEvents(std::vector<neosmart::neosmart_event_t>& events)
+{
+	for (auto event : events)
+		neosmart::DestroyEvent(event);
+	events.clear();
+}
+
+TEST(LowlevelWfmoTest, TestWaitAny)
+{
+	auto events = createEvents(3, false);
+	int index = -2;
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForMultipleEvents(events.data(), 3, false, 0, index));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForMultipleEvents(events.data(), 3, false, 10));
+	EXPECT_EQ(-1, index);
+
+	// already signaled, only the first signaled event is taken
+	neosmart::SetEvent(events[1]);
+	neosmart::SetEvent(events[2]);
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 3, false, 0, index));
+	EXPECT_EQ(1, index);
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[1], 0));
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 3, false, 0, index));
+	EXPECT_EQ(2, index);
+
+	// signaled while blocked
+	std::thread setter([&events]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		neosmart::SetEvent(events[2]);
+	});
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 3, false, std::chrono::nanoseconds::max(), index));
+	EXPECT_EQ(2, index);
+	setter.join();
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[2], 0));
+
+	destroyEvents(events);
+}
+
+TEST(LowlevelWfmoTest, TestWaitAll)
+{
+	auto events = createEvents(2, true);
+	events.push_back(neosmart::CreateEvent(false, false));
+
+	neosmart::SetEvent(events[0]);
+	neosmart::SetEvent(events[1]);
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForMultipleEvents(events.data(), 3, true, 10));
+
+	std::thread setter([&events]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		neosmart::SetEvent(events[2]);
+	});
+	int index = -2;
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 3, true, std::chrono::seconds(10), index));
+	EXPECT_EQ(-1, index);
+	setter.join();
+
+	// the manual reset events stay signaled, the auto reset one was consumed by the wait
+	EXPECT_EQ(0, neosmart::WaitForEvent(events[0], 0));
+	EXPECT_EQ(0, neosmart::WaitForEvent(events[1], 0));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[2], 0));
+
+	// all already signaled
+	neosmart::SetEvent(events[2]);
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 3, true, 0));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[2], 0));
+
+	destroyEvents(events);
+}
+
+TEST(LowlevelWfmoTest, TestTimeoutRacingSet)
+{
+	// whichever of the timeout and SetEvent wins, an auto reset event is either taken by the wait or still
+	// signaled afterwards, never lost and never taken twice
+	auto events = createEvents(2, false);
+	int taken = 0, timedOut = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		std::atomic<bool> go(false);
+		std::thread setter([&events, &go, i]()
+		{
+			while (!go.load(std::memory_order_acquire))
+				;
+			if (i & 1)
+				std::this_thread::yield();
+			neosmart::SetEvent(events[1]);
+		});
+		go.store(true, std::memory_order_release);
+		int index = -2;
+		int result = neosmart::WaitForMultipleEvents(events.data(), 2, false, std::chrono::microseconds(i % 50), index);
+		setter.join();
+
+		if (result == 0)
+		{
+			EXPECT_EQ(1, index);
+			EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[1], 0));
+			taken++;
+		}
+		else
+		{
+			ASSERT_EQ(WAIT_TIMEOUT, result);
+			EXPECT_EQ(-1, index);
+			EXPECT_EQ(0, neosmart::WaitForEvent(events[1], 0));
+			timedOut++;
+		}
+		EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[0], 0));
+	}
+	EXPECT_EQ(2000, taken + timedOut);
+
+	destroyEvents(events);
+}
+
+TEST(LowlevelWfmoTest, TestGrowingWaits)
+{
+	// the same thread waits on more events each time, so the links it reuses between calls have to grow
+	// while events still signal the right wait
+	for (int count = 1; count <= 64; count++)
+	{
+		auto events = createEvents(count, false);
+		int target = (count * 5) / 7;
+		std::thread setter([&events, target]()
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			neosmart::SetEvent(events[target]);
+		});
+		int index = -2;
+		EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), count, false, std::chrono::seconds(10), index));
+		EXPECT_EQ(target, index);
+		setter.join();
+
+		for (auto event : events)
+			neosmart::SetEvent(event);
+		EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), count, true, 0));
+		for (auto event : events)
+			EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(event, 0));
+
+		destroyEvents(events);
+	}
+
+	// and back down again with the grown links
+	auto events = createEvents(2, false);
+	neosmart::SetEvent(events[1]);
+	int index = -2;
+	EXPECT_EQ(0, neosmart::WaitForMultipleEvents(events.data(), 2, false, 0, index));
+	EXPECT_EQ(1, index);
+	destroyEvents(events);
+}
+
+TEST(LowlevelWfmoTest, TestAutoResetConsumption)
+{
+	// every SetEvent of an auto reset event releases exactly one of the waiters
+	auto events = createEvents(2, false);
+	const int waiters = 4;
+	std::atomic<int> released(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < waiters; t++)
+		threads.emplace_back([&events, &released]()
+		{
+			int index = -2;
+			if (neosmart::WaitForMultipleEvents(events.data(), 2, false, std::chrono::seconds(10), index) == 0 && index == 0)
+				released++;
+		});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	for (int i = 1; i <= waiters; i++)
+	{
+		neosmart::SetEvent(events[0]);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (released.load() < i && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		EXPECT_EQ(i, released.load());
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[0], 0));
+	EXPECT_EQ(WAIT_TIMEOUT, neosmart::WaitForEvent(events[1], 0));
+
+	destroyEvents(events);
+}
+}